@@ -0,0 +1,66 @@
+
+
+#include "../include/broadcast_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <syncstream>
+#include <thread>
+#include <vector>
+auto main() -> int
+{
+    auto now = []() {
+        return std::chrono::steady_clock::now();
+    };
+    constexpr auto total_pushs = 10'000'000ull;
+    constexpr auto subscriber_count = 3u;
+    auto scout{std::osyncstream{std::cout}};
+    const auto buff_capacity = 32768;
+    auto ring = BroadcastRing<unsigned long long>(buff_capacity, subscriber_count);
+    auto subscribers = std::vector<BroadcastRing<unsigned long long>::Subscriber>();
+    for(auto i{0u}; i < subscriber_count; ++i)
+        subscribers.push_back(ring.subscribe());
+    auto futs = std::vector<std::future<unsigned long long>>();
+    auto sum{[&scout](BroadcastRing<unsigned long long>::Subscriber& subscriber, auto thn) {
+        scout << "start subscriber-thread #" << thn << '\n';
+        auto sum{0ull};
+        auto i{0ull};
+        while(auto visited = subscriber.consume([&sum](const unsigned long long& value) { sum += value; }))
+            i += visited;
+        scout << "finished subscriber-thread #" << thn << ", total reads: " << i << '\n';
+        return sum;
+    }};
+    scout << "broadcast ring capacity: { " << ring.capacity() << " }" << '\n';
+    scout << "total pushs to make by main thread: { " << total_pushs << " }\n";
+    const auto total_sum = (total_pushs * (total_pushs - 1)) / 2;
+    scout << "Expected: { SUM(read elements)==" << total_sum << " for each of " << subscriber_count << " subscribers }\n";
+    scout << ">>>start processing...\n";
+    auto start = now();
+    for(auto i{0u}; i < subscriber_count; ++i)
+        futs.push_back(std::async(std::launch::async, sum, std::ref(subscribers[i]), i + 1));
+    for(auto i{0ull}; i < total_pushs; ++i)
+        ring.push(i);
+    ring.close();
+    auto all_passed = true;
+    auto sums = std::vector<unsigned long long>();
+    for(auto& partial_sum : futs)
+        sums.push_back(partial_sum.get());
+    auto end = now();
+    scout << ">>>processing finished\n";
+    using namespace std::string_literals;
+    for(auto i{0u}; i < subscriber_count; ++i) {
+        const auto passed = sums[i] == total_sum;
+        all_passed = all_passed && passed;
+        scout << "Actuall: { subscriber #" << i + 1 << " SUM(read elements)==" << sums[i] << " }" << (passed ? " => as Expected"s : " => Failed"s) << '\n';
+    }
+    if(all_passed) {
+        scout << "### BroadcastRing Test PASSED ###\n";
+        scout << "execution time: " << std::chrono::duration<double>(end - start).count() << " seconds\n";
+        return 0;
+    }
+    scout << ">>> BroadcastRing Test FAILED <<<\n";
+    return 1;
+}
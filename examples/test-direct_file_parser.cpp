@@ -0,0 +1,106 @@
+
+
+#include "../include/DirectFileParser.h"
+#include "../include/PooledFileParser.h"
+#include "test_check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <syncstream>
+#include <vector>
+struct expected_line
+{
+    std::string id;
+    int quantity;
+};
+
+template<class Reader>
+auto drain(Reader& reader)
+{
+    auto records = std::vector<std::unique_ptr<Record>>();
+    while(reader.good())
+        records.emplace_back(reader.getRecord());
+    return records;
+}
+auto main() -> int
+{
+    std::ios_base::sync_with_stdio(false);
+    auto scout{std::osyncstream{std::cout}};
+    using namespace std::string_literals;
+    auto check = test_check(scout);
+    const auto path = (std::filesystem::temp_directory_path() / "test-direct_file_parser.csv").string();
+    // ids of varying length so that lines straddle every chunk boundary;
+    // the file size is not a multiple of the O_DIRECT alignment
+    constexpr auto line_count = 40'001;
+    auto write = [&path](const std::string& ending, bool terminated) {
+        auto expected = std::vector<expected_line>();
+        auto os = std::ofstream(path, std::ios::binary | std::ios::trunc);
+        for(auto i{0}; i < line_count; ++i) {
+            expected.push_back({"id" + std::string(static_cast<std::size_t>(i % 37), 'x') + std::to_string(i), i});
+            os << expected.back().id << ',' << i << ',' << i % 1000 << ".5";
+            if(terminated || i + 1 < line_count)
+                os << ending;
+        }
+        return expected;
+    };
+    auto matches = [](const std::vector<std::unique_ptr<Record>>& records, const std::vector<expected_line>& expected) {
+        if(records.size() != expected.size())
+            return false;
+        for(auto i{0u}; i < records.size(); ++i)
+            if(!records[i]->Valid() || records[i]->getId() != expected[i].id ||
+               records[i]->getQuantity() != expected[i].quantity ||
+               records[i]->getPrice() != (expected[i].quantity % 1000) + 0.5)
+                return false;
+        return true;
+    };
+
+    auto direct_used = false;
+    for(const auto chunk_size : {std::size_t{4096}, std::size_t{8192}, DEFAULT_BUFFER_SIZE})
+        for(const auto& [ending_name, ending] : {std::pair{"CRLF"s, "\r\n"s}, std::pair{"LF"s, "\n"s}})
+            for(const auto terminated : {true, false}) {
+                const auto expected = write(ending, terminated);
+                auto parser = DirectRecordParser(path, "feed", csv, {.chunkSize = chunk_size, .depth = 3});
+                direct_used = direct_used || parser.direct();
+                check(std::to_string(chunk_size) + " byte chunks, " + ending_name +
+                          (terminated ? ", terminated" : ", unterminated last line"),
+                      matches(drain(parser), expected), true);
+            }
+    scout << "O_DIRECT " << (direct_used ? "used" : "unsupported here, buffered fallback") << '\n';
+    {
+        const auto expected = write("\r\n", true);
+        auto parser = DirectRecordParser(path, "feed", csv, {.chunkSize = 1 << 20, .depth = 2, .hugePages = true});
+        check("huge page buffers", matches(drain(parser), expected), true);
+    }
+
+    // every reader ends the same way
+    auto end_of_stream = [&](const std::string& content, auto&& add_filter) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+        auto buffers = BufferPool(1, 4096);
+        auto files = FileHandleCache(1);
+        auto file = RecordParser(path, "feed", csv);
+        auto pooled = PooledRecordParser(path, "feed", csv, buffers, files);
+        auto direct = DirectRecordParser(path, "feed", csv, {.chunkSize = 4096});
+        add_filter(file);
+        add_filter(pooled);
+        add_filter(direct);
+        const auto counts = std::vector<std::size_t>{drain(file).size(), drain(pooled).size(), drain(direct).size()};
+        return counts;
+    };
+    auto no_filter = [](auto&) {};
+    auto keep_a = [](auto& reader) { reader.addFilter(IdPrefixPredicate("a")); };
+    using counts = std::vector<std::size_t>;
+    check("terminated input, no trailing record", end_of_stream("a,1,1.00\r\nb,2,2.00\r\n", no_filter), counts(3, 2));
+    check("unterminated input, no trailing record", end_of_stream("a,1,1.00\r\nb,2,2.00", no_filter), counts(3, 2));
+    check("empty input, one invalid record", end_of_stream("", no_filter), counts(3, 1));
+    check("rejected last lines, one invalid record", end_of_stream("a,1,1.00\r\nb,2,2.00\r\n", keep_a), counts(3, 2));
+    std::filesystem::remove(path);
+    if(check.all_passed()) {
+        scout << "### Direct File Parser Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Direct File Parser Test FAILED <<<\n";
+    return 1;
+}
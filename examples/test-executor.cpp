@@ -0,0 +1,131 @@
+
+
+#include "../include/ChunkExtractor.h"
+#include "../include/executor.h"
+#include "../include/generator.h"
+#include "test_check.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <syncstream>
+#include <thread>
+#include <vector>
+static_assert(std::ranges::input_range<generator<int>>);
+static_assert(std::ranges::view<generator<int>>);
+static_assert(std::ranges::input_range<generator<std::string_view>>);
+
+generator<int> iota(int count)
+{
+    for(auto i{0}; i < count; ++i)
+        co_yield i;
+}
+
+task produce(executor& exec, RingBuffer<unsigned long long>& ring, unsigned long long count,
+             std::chrono::milliseconds delay)
+{
+    // nothing to pop while the io thread sleeps; consumers stay parked
+    co_await exec.blocking([delay] { std::this_thread::sleep_for(delay); });
+    for(auto i{0ull}; i < count; ++i)
+        co_await async_push(exec, ring, i);
+    ring.close();
+}
+
+task consume(executor& exec, RingBuffer<unsigned long long>& ring, std::atomic<unsigned long long>& sum,
+             std::atomic<unsigned long long>& popped)
+{
+    while(auto value = co_await async_pop(exec, ring)) {
+        sum += *value;
+        ++popped;
+    }
+}
+
+task read_size(executor& exec, std::string path, std::uintmax_t& size)
+{
+    size = co_await exec.blocking([&path] { return std::filesystem::file_size(path); });
+    co_await exec.blocking([] { throw std::runtime_error("io failure"); });
+}
+auto main() -> int
+{
+    std::ios_base::sync_with_stdio(false);
+    auto scout{std::osyncstream{std::cout}};
+    using namespace std::string_literals;
+    auto check = test_check(scout);
+
+    auto evens = 0;
+    for(auto value : iota(10) | std::views::filter([](int value) { return value % 2 == 0; }))
+        evens += value;
+    check("generator through views::filter", evens, 20);
+
+    const auto path = (std::filesystem::temp_directory_path() / "test-executor.csv").string();
+    std::ofstream(path, std::ios::binary) << "abc1,10,12.50\r\nxyz2,20,30.00\r\nabc3,30,99.90\r\n";
+    {
+        auto parser = RecordParser(path, "feed", csv);
+        auto ids = std::vector<std::string>();
+        for(auto* record : records(parser)) {
+            auto owned = std::unique_ptr<Record>(record);
+            if(owned && owned->Valid())
+                ids.push_back(owned->getId());
+        }
+        check("records() yields every valid record", ids, std::vector<std::string>{"abc1", "xyz2", "abc3"});
+    }
+    {
+        auto parser = RecordParser(path, "feed", csv);
+        parser.addFilter(IdPrefixPredicate("abc"));
+        auto lines_seen = std::vector<std::string>();
+        for(auto line : lines(parser))
+            lines_seen.emplace_back(line);
+        check("lines() applies the raw-line filters", lines_seen,
+              std::vector<std::string>{"abc1,10,12.50", "abc3,30,99.90"});
+    }
+
+    {
+        constexpr auto consumers = 1000;
+        constexpr auto count = 100'000ull;
+        constexpr auto delay = std::chrono::milliseconds(300);
+        auto exec = executor(2, 1);
+        // small ring so that the producer parks in async_push as well
+        auto ring = RingBuffer<unsigned long long>(16);
+        auto sum = std::atomic<unsigned long long>{0};
+        auto popped = std::atomic<unsigned long long>{0};
+        for(auto i{0}; i < consumers; ++i)
+            exec.spawn(consume(exec, ring, sum, popped));
+        exec.spawn(produce(exec, ring, count, delay));
+        const auto cpu_start = std::clock();
+        const auto wall_start = std::chrono::steady_clock::now();
+        exec.run();
+        const auto cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        const auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        check("async_push/async_pop deliver every element", popped.load(), count);
+        check("async_pop sum", sum.load(), count * (count - 1) / 2);
+        scout << "parked " << consumers << " tasks: cpu " << cpu << "s, wall " << wall << "s\n";
+        // the consumers sleep through the producer's delay instead of polling
+        check("parked tasks do not spin", cpu < wall - delay.count() / 2000.0, true);
+    }
+    {
+        auto exec = executor(1, 1);
+        auto size = std::uintmax_t{0};
+        exec.spawn(read_size(exec, path, size));
+        auto error = ""s;
+        try {
+            exec.run();
+        } catch(const std::runtime_error& failure) {
+            error = failure.what();
+        }
+        check("blocking() returns the io result", size, std::filesystem::file_size(path));
+        check("blocking() rethrows in the task", error, "io failure"s);
+    }
+    std::filesystem::remove(path);
+    if(check.all_passed()) {
+        scout << "### Executor Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Executor Test FAILED <<<\n";
+    return 1;
+}
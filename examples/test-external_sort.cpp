@@ -0,0 +1,152 @@
+
+
+#include "../include/ExternalSort.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <malloc.h>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <syncstream>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+// heap bytes in use and their high-water mark, to check the sorter's budget
+std::atomic<std::size_t> live_bytes{0};
+std::atomic<std::size_t> peak_bytes{0};
+
+void* operator new(std::size_t size)
+{
+    auto* allocated = std::malloc(size ? size : 1);
+    if(!allocated)
+        throw std::bad_alloc();
+    const auto live = live_bytes.fetch_add(malloc_usable_size(allocated)) + malloc_usable_size(allocated);
+    auto peak = peak_bytes.load();
+    while(live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+    }
+    return allocated;
+}
+void operator delete(void* allocated) noexcept
+{
+    if(!allocated)
+        return;
+    live_bytes.fetch_sub(malloc_usable_size(allocated));
+    std::free(allocated);
+}
+void operator delete(void* allocated, std::size_t) noexcept { operator delete(allocated); }
+
+// sorts `count` records added one by one; returns {sorted, ordered}
+auto sort_records(ExternalSorter& sorter, unsigned long long count)
+{
+    auto random = std::mt19937_64{42};
+    for(auto i{0ull}; i < count; ++i)
+        sorter.add(Record("id" + std::to_string(random() % (count / 4)), static_cast<int>(i),
+                          static_cast<double>(random() % 1000) + 0.5, "feed"));
+    auto sorted{0ull};
+    auto ordered = true;
+    auto previous = std::unique_ptr<Record>();
+    sorter.merge([&](Record* record) {
+        auto current = std::unique_ptr<Record>(record);
+        if(previous && (previous->getId() > current->getId() ||
+                        (previous->getId() == current->getId() && previous->getPrice() > current->getPrice())))
+            ordered = false;
+        previous = std::move(current);
+        ++sorted;
+    });
+    return std::pair{sorted, ordered};
+}
+auto main() -> int
+{
+    auto now = []() {
+        return std::chrono::steady_clock::now();
+    };
+    constexpr auto total_records = 1'000'000ull;
+    constexpr auto producer_count = 2u;
+    auto scout{std::osyncstream{std::cout}};
+    // small budget so the input is spilled and merged in more than one pass
+    auto sorter = ExternalSorter({.memoryBudget = 1ul << 20, .parallelism = 2});
+    auto ring = RingBuffer<Record*>(4096);
+    scout << "total records to sort: { " << total_records << " }, memory budget: { 1 MiB }\n";
+    scout << ">>>start processing...\n";
+    auto start = now();
+    {
+        auto producers = std::vector<std::jthread>();
+        for(auto p{0u}; p < producer_count; ++p)
+            producers.emplace_back([&ring, p]() {
+                auto random = std::mt19937_64{p};
+                for(auto i{p}; i < total_records; i += producer_count)
+                    ring.push(new Record("id" + std::to_string(random() % (total_records / 4)), static_cast<int>(i),
+                                         static_cast<double>(random() % 1000) + 0.5, "feed" + std::to_string(p)));
+            });
+        auto closer = std::jthread([&ring, &producers]() {
+            for(auto& producer : producers)
+                producer.join();
+            ring.close();
+        });
+        sorter.consume(ring);
+    }
+    const auto spilled = sorter.spilledRuns();
+    auto sorted{0ull};
+    auto ordered = true;
+    auto previous = std::unique_ptr<Record>();
+    sorter.merge([&](Record* record) {
+        auto current = std::unique_ptr<Record>(record);
+        if(previous && (previous->getId() > current->getId() ||
+                        (previous->getId() == current->getId() && previous->getPrice() > current->getPrice())))
+            ordered = false;
+        previous = std::move(current);
+        ++sorted;
+    });
+    auto end = now();
+    scout << ">>>processing finished\n";
+    scout << "spilled runs: { " << spilled << " }\n";
+    auto test_passed = ordered && sorted == total_records && spilled > 1;
+    using namespace std::string_literals;
+    scout << "Actuall: { sorted records==" << sorted << ", ordered by id then price==" << std::boolalpha << ordered
+          << " }" << (test_passed ? " => as Expected"s : " => Failed"s) << '\n';
+    scout << "Time elapsed: " << std::chrono::duration<double>(end - start).count() << "s\n";
+    {
+        // records are added from the stack, so the heap growth is the
+        // sorter's own: runs, spill and merge buffers, bookkeeping
+        const auto baseline = live_bytes.load();
+        peak_bytes.store(baseline);
+        auto budgeted = ExternalSorter({.memoryBudget = 1ul << 20, .parallelism = 2});
+        auto [budget_sorted, budget_ordered] = sort_records(budgeted, 300'000);
+        const auto peak = peak_bytes.load() - baseline;
+        const auto passed = budget_sorted == 300'000 && budget_ordered && peak <= (1ul << 20);
+        test_passed = test_passed && passed;
+        scout << "Actuall: { 1 MiB budget, peak heap growth==" << peak << " bytes }"
+              << (passed ? " => as Expected"s : " => Failed"s) << '\n';
+    }
+    {
+        // a merge must not open more runs than descriptors allow: 4 MiB
+        // over 16 shares spills about 50 runs, merged 16 at a time here
+        auto files = rlimit{};
+        getrlimit(RLIMIT_NOFILE, &files);
+        auto lowered = files;
+        lowered.rlim_cur = std::min<rlim_t>(files.rlim_cur, 32);
+        setrlimit(RLIMIT_NOFILE, &lowered);
+        auto passed = false;
+        try {
+            auto many_runs = ExternalSorter({.memoryBudget = 4ul << 20, .parallelism = 15});
+            auto [fd_sorted, fd_ordered] = sort_records(many_runs, 300'000);
+            passed = fd_sorted == 300'000 && fd_ordered;
+        } catch(const std::exception& error) {
+            scout << error.what() << '\n';
+        }
+        setrlimit(RLIMIT_NOFILE, &files);
+        test_passed = test_passed && passed;
+        scout << "Actuall: { merge under a 32 descriptor limit }" << (passed ? " => as Expected"s : " => Failed"s)
+              << '\n';
+    }
+    if(test_passed) {
+        scout << "### External Sort Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> External Sort Test FAILED <<<\n";
+    return 1;
+}
@@ -0,0 +1,86 @@
+
+
+#include "../include/latency_trace.h"
+#include "../include/ring_buffer.h"
+#include "test_check.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <syncstream>
+#include <vector>
+auto main() -> int
+{
+    auto scout{std::osyncstream{std::cout}};
+    auto check = test_check(scout);
+    {
+        // every value falls into the bucket whose bounds surround it, and
+        // buckets above the linear range are at most 1/32 wide
+        auto bounds_hold = true;
+        auto width_holds = true;
+        auto monotonic = true;
+        auto values = std::vector<std::uint64_t>{0, 1, 63, 64, 65, 127, 128, 129, 1000, 4095, 4096, 123456789};
+        for(auto shift{7u}; shift < 64; ++shift)
+            for(auto value : {(1ull << shift) - 1, 1ull << shift, (1ull << shift) + 1, (3ull << (shift - 1)) + 7})
+                values.push_back(value);
+        values.push_back(~0ull);
+        for(auto value : values) {
+            const auto index = latency_histogram::bucket_index(value);
+            const auto lower = latency_histogram::bucket_lower_bound(index);
+            bounds_hold = bounds_hold && lower <= value && latency_histogram::bucket_index(lower) == index;
+            if(value == ~0ull)
+                continue; // last bucket
+            const auto upper = latency_histogram::bucket_lower_bound(index + 1);
+            bounds_hold = bounds_hold && value < upper;
+            width_holds = width_holds && (value < 64 ? upper - lower == 1 : (upper - lower) * 32 <= lower);
+            monotonic = monotonic && latency_histogram::bucket_index(value + 1) >= index;
+        }
+        check("bucket lower bound <= value < next lower bound", bounds_hold, true);
+        check("bucket width exact below 64 ns, within 1/32 above", width_holds, true);
+        check("bucket index monotonic", monotonic, true);
+        check("linear range bucket_index(63)", latency_histogram::bucket_index(63), std::size_t{63});
+        check("first log bucket bucket_index(64)", latency_histogram::bucket_index(64), std::size_t{64});
+        check("bucket_index(65) shares it", latency_histogram::bucket_index(65), std::size_t{64});
+        check("bucket_lower_bound(96) == 128", latency_histogram::bucket_lower_bound(96), std::uint64_t{128});
+    }
+    {
+        auto histogram = latency_histogram();
+        check("empty percentile", histogram.percentile(50), std::uint64_t{0});
+        for(auto value{1ull}; value <= 1000; ++value)
+            histogram.record(value);
+        auto near = [](std::uint64_t actual, std::uint64_t expected) {
+            return actual >= expected && actual <= expected + expected / 32;
+        };
+        check("count", histogram.count(), std::uint64_t{1000});
+        check("max", histogram.max(), std::uint64_t{1000});
+        check("p0 is the smallest bucket", histogram.percentile(0), std::uint64_t{1});
+        check("p50 within a bucket of 500", near(histogram.percentile(50), 500), true);
+        check("p90 within a bucket of 900", near(histogram.percentile(90), 900), true);
+        check("p99 within a bucket of 990", near(histogram.percentile(99), 990), true);
+        check("p100 is the max", histogram.percentile(100), std::uint64_t{1000});
+        histogram.reset();
+        check("reset", histogram.count() + histogram.max(), std::uint64_t{0});
+    }
+    {
+        // tracing stores raw ticks, so the first traced record through a
+        // ring does not carry the 10 ms calibration sleep; nothing in main()
+        // calibrates before the first pop
+        auto ring = RingBuffer<traced<int>>(16);
+        for(auto i{0}; i < 4; ++i)
+            ring.push(traced<int>{i, tsc_clock::now(), 0});
+        for(auto i{0}; i < 4; ++i)
+            ring.pop();
+        auto& tracer = latency_tracer::instance();
+        const auto& queued = tracer.histogram(latency_tracer::enqueue_to_dequeue);
+        check("traced records", queued.count(), std::uint64_t{4});
+        check("enqueue->dequeue below 1 ms", tracer.max_ns(latency_tracer::enqueue_to_dequeue) < 1'000'000, true);
+        tracer.report(scout);
+    }
+    if(check.all_passed()) {
+        scout << "### Latency Trace Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Latency Trace Test FAILED <<<\n";
+    return 1;
+}
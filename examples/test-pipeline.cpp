@@ -0,0 +1,99 @@
+
+
+#include "../include/pipeline.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <syncstream>
+#include <thread>
+auto main() -> int
+{
+    auto now = []() {
+        return std::chrono::steady_clock::now();
+    };
+    constexpr auto total_pushs = 1'000'000ull;
+    auto scout{std::osyncstream{std::cout}};
+    auto thn = std::max(2u, std::thread::hardware_concurrency());
+    auto generated{0ull};
+    auto total_sum_consumed = std::atomic<unsigned long long>{0};
+    auto pipeline = Pipeline::from(
+                        "generate",
+                        [&generated]() -> std::optional<unsigned long long> {
+                            if(generated == total_pushs)
+                                return std::nullopt;
+                            return generated++;
+                        },
+                        4096)
+                        .then("double", [](unsigned long long value) { return value * 2; }, thn / 2, 4096)
+                        .then("format", [](unsigned long long value) { return std::to_string(value); }, thn / 2, 1024)
+                        .sink("sum", [&total_sum_consumed](std::string value) { total_sum_consumed += std::stoull(value); }, 2);
+    // keep every stage on the first node: workers pinned, edges allocated there
+    const auto topology = CpuTopology::detect();
+    pipeline->place_on(NodePlacement(topology, topology.nodes().front()));
+    const auto total_sum = total_pushs * (total_pushs - 1);
+    scout << "total pushs to make by source stage: { " << total_pushs << " }\n";
+    scout << "Expected: { SUM(consumed elements)==" << total_sum << " }\n";
+    scout << ">>>start processing...\n";
+    auto start = now();
+    pipeline->run();
+    auto end = now();
+    scout << ">>>processing finished\n";
+    pipeline->report(scout);
+    const auto test1_passed = (total_sum_consumed == total_sum);
+    using namespace std::string_literals;
+    scout << "Actuall: { SUM(consumed elements)==" << total_sum_consumed << " }" << (test1_passed ? " => as Expected"s : " => Failed"s) << '\n';
+
+    auto aborted_pipeline = Pipeline::from("generate", []() -> std::optional<int> { return 1; }, 64)
+                                .sink("fail", [](int) { throw std::logic_error("sink failure"); });
+    auto test2_passed = false;
+    try {
+        aborted_pipeline->run();
+    } catch(const std::logic_error&) {
+        test2_passed = true;
+    }
+    scout << "Actuall: { stage failure propagated to run() }" << (test2_passed ? " => as Expected"s : " => Failed"s) << '\n';
+
+    // the source fails with items still queued: the sink finishes the one it
+    // holds and drops the rest instead of draining them
+    auto sink_started = std::atomic_bool{false};
+    auto source_failed = std::atomic_bool{false};
+    auto produced{0};
+    auto drained = std::atomic<int>{0};
+    auto dropping_pipeline = Pipeline::from(
+                                 "generate",
+                                 [&produced, &sink_started, &source_failed]() -> std::optional<int> {
+                                     if(produced == 100) {
+                                         while(!sink_started)
+                                             std::this_thread::yield();
+                                         source_failed = true;
+                                         throw std::runtime_error("source failure");
+                                     }
+                                     return produced++;
+                                 },
+                                 128)
+                                 .sink("slow", [&drained, &sink_started, &source_failed](int) {
+                                     if(drained == 0) {
+                                         sink_started = true;
+                                         while(!source_failed)
+                                             std::this_thread::yield();
+                                         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                                     }
+                                     ++drained;
+                                 });
+    try {
+        dropping_pipeline->run();
+    } catch(const std::runtime_error&) {
+    }
+    const auto test3_passed = (drained == 1);
+    scout << "Actuall: { items processed after abort==" << drained - 1 << " }" << (test3_passed ? " => as Expected"s : " => Failed"s) << '\n';
+    if(test1_passed && test2_passed && test3_passed) {
+        scout << "### Pipeline Test PASSED ###\n";
+        scout << "execution time: " << std::chrono::duration<double>(end - start).count() << " seconds\n";
+        return 0;
+    }
+    scout << ">>> Pipeline Test FAILED <<<\n";
+    return 1;
+}
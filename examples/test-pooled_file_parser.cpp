@@ -0,0 +1,140 @@
+
+
+#include "../include/PooledFileParser.h"
+#include "test_check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <syncstream>
+#include <vector>
+auto main() -> int
+{
+    std::ios_base::sync_with_stdio(false);
+    auto scout{std::osyncstream{std::cout}};
+    auto check = test_check(scout);
+    const auto directory = std::filesystem::temp_directory_path() / "test-pooled_file_parser";
+    std::filesystem::create_directories(directory);
+    auto write_feed = [&directory](const std::string& name, int lines) {
+        const auto path = (directory / name).string();
+        auto os = std::ofstream(path, std::ios::binary | std::ios::trunc);
+        for(auto i{0}; i < lines; ++i)
+            os << name << '-' << i << ',' << i << ',' << i % 100 << ".25\r\n";
+        return path;
+    };
+
+    {
+        // more readers than chunks and descriptors
+        constexpr auto feeds = 3;
+        constexpr auto lines = 20'000;
+        auto buffers = BufferPool(2, 4096);
+        auto files = FileHandleCache(1);
+        auto readers = std::vector<std::unique_ptr<PooledRecordParser>>();
+        auto scheduler = ReaderScheduler<PooledRecordParser>(100);
+        auto file_bytes = std::uintmax_t{0};
+        for(auto f{0}; f < feeds; ++f) {
+            const auto path = write_feed("feed" + std::to_string(f), lines);
+            file_bytes += std::filesystem::file_size(path);
+            readers.push_back(std::make_unique<PooledRecordParser>(path, "feed" + std::to_string(f), csv, buffers, files));
+            scheduler.add(*readers.back());
+        }
+        auto mutex = std::mutex();
+        auto quantities = std::map<std::string, std::vector<int>>();
+        auto max_open = std::size_t{0};
+        scheduler.run(
+            [&](Record* record) {
+                auto owned = std::unique_ptr<Record>(record);
+                std::lock_guard lock{mutex};
+                max_open = std::max(max_open, files.openCount());
+                if(owned->Valid())
+                    quantities[owned->getSourceStreamId()].push_back(owned->getQuantity());
+            },
+            2);
+        auto in_order = quantities.size() == feeds;
+        for(const auto& [feed, seen] : quantities) {
+            in_order = in_order && seen.size() == lines;
+            for(auto i{0u}; in_order && i < seen.size(); ++i)
+                in_order = seen[i] == static_cast<int>(i);
+        }
+        check("3 readers over 2 chunks and 1 descriptor, every line in order", in_order, true);
+        check("descriptors open at once <= 1", max_open <= 1, true);
+        auto bytes_read = std::uint64_t{0};
+        for(const auto& reader : readers)
+            bytes_read += reader->bytesRead();
+        scout << "read " << bytes_read << " bytes for " << file_bytes << " bytes of feeds\n";
+        check("read amplification below 1.25", bytes_read < file_bytes * 5 / 4, true);
+    }
+    {
+        // default chunk size and quantum
+        const auto path = write_feed("large", 200'000);
+        auto buffers = BufferPool(1);
+        auto files = FileHandleCache(1);
+        auto reader = PooledRecordParser(path, "large", csv, buffers, files);
+        auto scheduler = ReaderScheduler<PooledRecordParser>();
+        scheduler.add(reader);
+        auto records = 0ull;
+        scheduler.run([&records](Record* record) {
+            records += record->Valid();
+            delete record;
+        });
+        check("default quantum delivers every record", records, 200'000ull);
+        const auto file_bytes = std::filesystem::file_size(path);
+        scout << "read " << reader.bytesRead() << " bytes for " << file_bytes << " bytes of feed\n";
+        check("default quantum read amplification below 1.25", reader.bytesRead() < file_bytes * 5 / 4, true);
+    }
+    {
+        // a failing reader drops out of the rotation; with one worker the
+        // other feeds still finish before run() reports it
+        auto buffers = BufferPool(1, 4096);
+        auto files = FileHandleCache(1);
+        auto good = std::vector<std::unique_ptr<PooledRecordParser>>();
+        auto missing = PooledRecordParser((directory / "missing").string(), "missing", csv, buffers, files);
+        auto scheduler = ReaderScheduler<PooledRecordParser>(100);
+        scheduler.add(missing);
+        for(auto f{0}; f < 2; ++f) {
+            const auto name = "healthy" + std::to_string(f);
+            good.push_back(std::make_unique<PooledRecordParser>(write_feed(name, 1'000), name, csv, buffers, files));
+            scheduler.add(*good.back());
+        }
+        auto records = 0ull;
+        auto failed = std::vector<std::string>();
+        try {
+            scheduler.run([&records](Record* record) {
+                records += record->Valid();
+                delete record;
+            });
+        } catch(const ReaderScheduleError& error) {
+            for(const auto& failure : error.failures())
+                failed.push_back(failure.readerId);
+        }
+        check("healthy readers drained past a failed one", records, 2'000ull);
+        check("failed reader reported", failed, std::vector<std::string>{"missing"});
+    }
+    {
+        // getRecord() refills a small batch, not a chunk worth of records
+        const auto path = write_feed("records", 20'000);
+        auto buffers = BufferPool(1);
+        auto files = FileHandleCache(1);
+        auto reader = PooledRecordParser(path, "records", csv, buffers, files);
+        auto records = 0ull;
+        auto max_pending = std::size_t{0};
+        while(reader.good()) {
+            auto record = std::unique_ptr<Record>(reader.getRecord());
+            records += record->Valid();
+            max_pending = std::max(max_pending, reader.pendingRecords());
+        }
+        check("getRecord delivers every record", records, 20'000ull);
+        check("getRecord buffers at most 64 records", max_pending <= 64, true);
+    }
+    std::filesystem::remove_all(directory);
+    if(check.all_passed()) {
+        scout << "### Pooled File Parser Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Pooled File Parser Test FAILED <<<\n";
+    return 1;
+}
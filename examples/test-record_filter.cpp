@@ -0,0 +1,107 @@
+
+
+#include "../include/ChunkExtractor.h"
+#include "test_check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <syncstream>
+#include <vector>
+// small chunks so that lines span the buffer boundary
+constexpr auto small_chunk = std::size_t{64};
+using SmallChunkParser =
+    FileParser<Record, RecordExtractFunctor<Record*, char, std::char_traits<char>, small_chunk>, char,
+               std::char_traits<char>, small_chunk>;
+
+template<class Parser>
+auto valid_ids(Parser& parser)
+{
+    auto ids = std::vector<std::string>();
+    while(parser.good()) {
+        auto record = std::unique_ptr<Record>(parser.getRecord());
+        if(record && record->Valid())
+            ids.push_back(record->getId());
+    }
+    return ids;
+}
+auto main() -> int
+{
+    std::ios_base::sync_with_stdio(false);
+    auto scout{std::osyncstream{std::cout}};
+    const auto path = std::filesystem::temp_directory_path() / "test-record_filter.csv";
+    auto write = [&path](const std::string& content) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+        return path.string();
+    };
+    using namespace std::string_literals;
+    auto check = test_check(scout);
+    auto ids = [](std::initializer_list<const char*> list) { return std::vector<std::string>(list.begin(), list.end()); };
+
+    // FileParser cuts two characters per line, so LF-only lines lose the
+    // last digit of the price; the values below keep it a zero
+    const auto crlf = "abc1,10,12.50\r\nxyz2,20,30.00\r\nabc3,30,99.90\r\n\r\nabc4,40,5.00\r\n"s;
+    const auto lf = "abc1,10,12.50\nxyz2,20,30.00\nabc3,30,99.90\n\nabc4,40,5.00\n\n"s;
+    for(const auto& [name, content] : {std::pair{"CRLF"s, crlf}, std::pair{"LF"s, lf}}) {
+        {
+            auto parser = RecordParser(write(content), "feed", csv);
+            parser.addFilter(IdPrefixPredicate("abc"));
+            check(name + " id prefix abc", valid_ids(parser), ids({"abc1", "abc3", "abc4"}));
+        }
+        {
+            auto parser = RecordParser(write(content), "feed", csv);
+            parser.addFilter(quantityRange(15, 35));
+            check(name + " quantity in [15, 35]", valid_ids(parser), ids({"xyz2", "abc3"}));
+        }
+        {
+            auto parser = RecordParser(write(content), "feed", csv);
+            parser.addFilter(IdPrefixPredicate("abc")).addFilter(priceRange(10.0, 50.0));
+            check(name + " prefix abc and price in [10, 50]", valid_ids(parser), ids({"abc1"}));
+        }
+    }
+    {
+        // empty lines only, nothing may match and nothing may be read past them
+        auto parser = RecordParser(write("\n\n\r\n\n"), "feed", csv);
+        parser.addFilter(IdPrefixPredicate("abc"));
+        check("empty lines rejected", valid_ids(parser).size(), std::size_t{0});
+    }
+    {
+        // ids of 16 bytes and more take the full-width compare
+        auto parser = RecordParser(write("instrument-0000001,1,1.00\r\ninstrument-0000002x,2,2.00\r\ninstrumenT-0000003,3,3.00\r\n"),
+                                   "feed", csv);
+        parser.addFilter(IdPrefixPredicate("instrument-00000"));
+        check("long id prefix", valid_ids(parser), ids({"instrument-0000001", "instrument-0000002x"}));
+    }
+    {
+        auto content = ""s;
+        auto expected = std::vector<std::string>();
+        for(auto i{0}; i < 100; ++i) {
+            const auto id = (i % 3 ? "abc"s : "zzz"s) + std::to_string(i * 7919);
+            content += id + "," + std::to_string(i) + "," + std::to_string(i) + ".50\r\n";
+            if(i % 3)
+                expected.push_back(id);
+        }
+        auto parser = SmallChunkParser(write(content), "feed", csv);
+        parser.addFilter(IdPrefixPredicate("abc"));
+        check("lines across a " + std::to_string(small_chunk) + " byte chunk boundary", valid_ids(parser), expected);
+    }
+    {
+        auto filter = LineFilter();
+        filter.add(IdPrefixPredicate("a"));
+        const auto line = "abc,1,1.00"s;
+        check("negative line length rejected", filter(line.data(), -1), false);
+        check("prefix longer than id rejected", IdPrefixPredicate("abcd")("abc,1,1.00"), false);
+        check("quantity with trailing garbage rejected", quantityRange(0, 100)("abc,12abc,1.00"), false);
+        check("price with trailing garbage rejected", priceRange(0, 100)("abc,12,1.5x"), false);
+        check("numeric fields accepted", quantityRange(0, 100)("abc,12,1.00") && priceRange(0, 100)("abc,12,1.00"), true);
+    }
+    std::filesystem::remove(path);
+    if(check.all_passed()) {
+        scout << "### Record Filter Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Record Filter Test FAILED <<<\n";
+    return 1;
+}
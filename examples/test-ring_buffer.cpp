@@ -1,19 +1,72 @@
 
 
 #include "../include/ring_buffer.h"
+#include "../include/segmented_queue.h"
+#include "../include/sharded_queue.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <future>
+#include <iomanip>
 #include <iostream>
 #include <numeric>
 #include <random>
 #include <ranges>
+#include <stdexcept>
 #include <string>
 #include <syncstream>
 #include <thread>
 #include <type_traits>
 #include <vector>
+// a ShardedQueue is used through per-thread handles, the other queues directly
+template<class Queue>
+decltype(auto) producer_of(Queue& queue)
+{
+    if constexpr(requires { queue.producer(); })
+        return queue.producer();
+    else
+        return (queue);
+}
+template<class Queue>
+decltype(auto) consumer_of(Queue& queue)
+{
+    if constexpr(requires { queue.consumer(); })
+        return queue.consumer();
+    else
+        return (queue);
+}
+// producers push their share of [0, total_pushs) and close the queue when
+// done; consumers pop until pop() reports it closed and drained
+template<class Queue>
+auto multi_producer_run(Queue& queue, unsigned producers, unsigned consumers, unsigned long long total_pushs)
+{
+    auto sums = std::vector<unsigned long long>(consumers);
+    auto start = std::chrono::steady_clock::now();
+    {
+        auto remaining_producers = std::atomic<unsigned>{producers};
+        auto threads = std::vector<std::jthread>();
+        for(auto c{0u}; c < consumers; ++c)
+            threads.emplace_back([&queue, &sum = sums[c]]() {
+                decltype(auto) consumer = consumer_of(queue);
+                try {
+                    for(;;)
+                        sum += consumer.pop();
+                } catch(const std::runtime_error&) {
+                }
+            });
+        for(auto p{0u}; p < producers; ++p)
+            threads.emplace_back([&queue, &remaining_producers, p, producers, total_pushs]() {
+                decltype(auto) producer = producer_of(queue);
+                for(auto i{static_cast<unsigned long long>(p)}; i < total_pushs; i += producers)
+                    producer.push(i);
+                if(remaining_producers.fetch_sub(1) == 1)
+                    queue.close();
+            });
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::pair{std::accumulate(sums.begin(), sums.end(), 0ull), std::chrono::duration<double>(end - start).count()};
+}
 auto main() -> int
 {
     auto now = []() {
@@ -21,7 +74,7 @@ auto main() -> int
     };
     constexpr auto total_pushs = 10'000'000ull;
     auto scout{std::osyncstream{std::cout}};
-    auto thn = std::thread::hardware_concurrency();
+    auto thn = std::max(2u, std::thread::hardware_concurrency());
     auto pop_counts = std::vector<uint64_t>(thn - 1);
     auto futs = std::vector<std::future<unsigned long long>>();
     futs.reserve(thn - 1);
@@ -76,9 +129,68 @@ auto main() -> int
     using namespace std::string_literals;
     scout << "Actuall: { after processing, ring_buffer size==" << rb.size() << " }" << (test1_passed ? " => as Expected"s : " => Failed"s) << '\n';
     scout << "Actuall: { SUM(popped elements)==" << total_sum_popped << " }" << (test2_passed ? " => as Expected"s : " => Failed"s) << '\n';
-    if(test1_passed && test2_passed) {
+    scout << "execution time: " << std::chrono::duration<double>(end - start).count() << " seconds\n";
+
+    // many producers and many consumers: one shared RingBuffer against the
+    // same capacity sharded per hardware thread and the unbounded
+    // SegmentedQueue capped at it; once with the hardware threads split
+    // between the two sides, once with 4 + 4 threads contending
+    auto compare = [&](unsigned producers, unsigned consumers, unsigned long long pushs) {
+        const auto multi_sum = (pushs * (pushs - 1)) / 2;
+        scout << ">>>" << producers << " producers, " << consumers << " consumers, " << pushs << " pushs\n";
+        auto shared_rb = RingBuffer<unsigned long long>(buff_capacity);
+        auto [shared_sum, shared_seconds] = multi_producer_run(shared_rb, producers, consumers, pushs);
+        auto sharded = ShardedQueue<unsigned long long>(buff_capacity, thn);
+        auto [sharded_sum, sharded_seconds] = multi_producer_run(sharded, producers, consumers, pushs);
+        auto segmented = SegmentedQueue<unsigned long long>(buff_capacity);
+        auto [segmented_sum, segmented_seconds] = multi_producer_run(segmented, producers, consumers, pushs);
+        scout << std::fixed << std::setprecision(1);
+        scout << "RingBuffer:     " << std::setw(7) << pushs / shared_seconds / 1e6 << " Mops/s" << (shared_sum == multi_sum ? ""s : " => SUM Failed"s) << '\n';
+        scout << "ShardedQueue:   " << std::setw(7) << pushs / sharded_seconds / 1e6 << " Mops/s ("
+              << sharded.shard_count() << " shards)" << (sharded_sum == multi_sum ? ""s : " => SUM Failed"s) << '\n';
+        scout << "SegmentedQueue: " << std::setw(7) << pushs / segmented_seconds / 1e6 << " Mops/s"
+              << (segmented_sum == multi_sum ? ""s : " => SUM Failed"s) << '\n';
+        scout << std::defaultfloat;
+        return shared_sum == multi_sum && sharded_sum == multi_sum && segmented_sum == multi_sum;
+    };
+    const auto split_producers = std::max(1u, thn / 2);
+    auto test3_passed = compare(split_producers, std::max(1u, thn - split_producers), total_pushs);
+    test3_passed = compare(4, 4, total_pushs / 10) && test3_passed;
+    // homes are registered per queue: another queue's producers and
+    // producers that left do not move consumers off the filled shards
+    auto test4_passed = true;
+    {
+        auto first = ShardedQueue<unsigned long long>(64, 4);
+        auto second = ShardedQueue<unsigned long long>(64, 4);
+        auto first_producers = std::vector<ShardedQueue<unsigned long long>::producer_handle>();
+        for(auto p{0}; p < 3; ++p)
+            first_producers.push_back(first.producer());
+        auto second_producer = second.producer();
+        auto second_consumer = second.consumer();
+        test4_passed = second_producer.home_shard() == 0 && second_consumer.home_shard() == 0;
+        {
+            auto leaving = std::vector<ShardedQueue<unsigned long long>::producer_handle>();
+            for(auto p{0}; p < 3; ++p)
+                leaving.push_back(second.producer());
+        }
+        auto later_consumer = second.consumer();
+        test4_passed = test4_passed && later_consumer.home_shard() == 0;
+        auto homes = std::vector<std::size_t>();
+        for(const auto& producer : first_producers)
+            homes.push_back(producer.home_shard());
+        test4_passed = test4_passed && homes == std::vector<std::size_t>{0, 1, 2};
+        auto first_consumers = std::vector<ShardedQueue<unsigned long long>::consumer_handle>();
+        for(auto c{0}; c < 4; ++c)
+            first_consumers.push_back(first.consumer());
+        homes.clear();
+        for(const auto& consumer : first_consumers)
+            homes.push_back(consumer.home_shard());
+        test4_passed = test4_passed && homes == std::vector<std::size_t>{0, 1, 2, 0};
+    }
+    scout << "Actuall: { ShardedQueue consumers homed on their own producers' shards }"
+          << (test4_passed ? " => as Expected"s : " => Failed"s) << '\n';
+    if(test1_passed && test2_passed && test3_passed && test4_passed) {
         scout << "### RingBuffer Test PASSED ###\n";
-        scout << "execution time: " << std::chrono::duration<double>(end - start).count() << " seconds\n";
         return 0;
     }
     scout << ">>> RingBuffer Test FAILED <<<\n";
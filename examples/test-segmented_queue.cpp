@@ -0,0 +1,118 @@
+
+
+#include "../include/segmented_queue.h"
+#include "test_check.h"
+
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <syncstream>
+#include <thread>
+#include <vector>
+// tiny segments so that every test crosses segment boundaries
+constexpr auto segment_size = std::size_t{4};
+using Queue = SegmentedQueue<unsigned long long, segment_size>;
+
+auto main() -> int
+{
+    auto scout{std::osyncstream{std::cout}};
+    auto check = test_check(scout);
+    {
+        auto queue = Queue();
+        auto value = 0ull;
+        check("empty queue try_pop", queue.try_pop(value), Queue::op_failed_buffer_empty);
+        for(auto i{0ull}; i < 10; ++i)
+            queue.push(i);
+        auto in_order = true;
+        for(auto i{0ull}; i < 10; ++i)
+            in_order = in_order && queue.pop() == i;
+        check("FIFO order across 3 segments", in_order, true);
+        check("size after draining", queue.size(), std::size_t{0});
+    }
+    {
+        // soft capacity 8 rounds up to 2 segments plus the one being drained
+        auto queue = Queue(8);
+        auto accepted = 0ull;
+        while(queue.try_push(accepted) == Queue::ok)
+            ++accepted;
+        check("soft capacity try_push full after", accepted, 3 * segment_size);
+        check("soft capacity full status", queue.try_push(0ull), Queue::op_failed_buffer_full);
+        check("soft capacity allocated segments", queue.allocated_segments(), std::size_t{3});
+        auto value = 0ull;
+        for(auto i{0u}; i <= segment_size; ++i)
+            queue.try_pop(value);
+        check("drained segment accepts pushes again", queue.try_push(0ull), Queue::ok);
+        check("no segment allocated past the cap", queue.allocated_segments(), std::size_t{3});
+    }
+    {
+        // a producer staying a few elements ahead of the consumer cycles
+        // through two segments
+        auto queue = Queue();
+        auto in_order = true;
+        auto next_pop = 0ull;
+        for(auto i{0ull}; i < 1000; ++i) {
+            queue.push(i);
+            if(i % 3 == 2)
+                while(queue.size())
+                    in_order = in_order && queue.pop() == next_pop++;
+        }
+        check("segments recycled, allocated", queue.allocated_segments(), std::size_t{2});
+        check("segments recycled, order kept", in_order, true);
+    }
+    {
+        auto queue = Queue();
+        for(auto i{0ull}; i < 10; ++i)
+            queue.push(i);
+        queue.close();
+        check("push after close", queue.try_push(10ull), Queue::error_closed);
+        auto value = 0ull;
+        auto drained = 0ull;
+        while(queue.try_pop(value) == Queue::ok && value == drained)
+            ++drained;
+        check("closed queue drained", drained, 10ull);
+        check("try_pop once drained", queue.try_pop(value), Queue::error_closed);
+        auto thrown = false;
+        try {
+            queue.pop();
+        } catch(const std::runtime_error&) {
+            thrown = true;
+        }
+        check("pop once drained throws", thrown, true);
+    }
+    {
+        // producers block on the soft cap, consumers pop until close()
+        constexpr auto total_pushs = 200'000ull;
+        constexpr auto producers = 2u;
+        constexpr auto consumers = 2u;
+        auto queue = Queue(16);
+        auto sums = std::vector<unsigned long long>(consumers);
+        {
+            auto remaining_producers = std::atomic<unsigned>{producers};
+            auto threads = std::vector<std::jthread>();
+            for(auto c{0u}; c < consumers; ++c)
+                threads.emplace_back([&queue, &sum = sums[c]]() {
+                    try {
+                        for(;;)
+                            sum += queue.pop();
+                    } catch(const std::runtime_error&) {
+                    }
+                });
+            for(auto p{0u}; p < producers; ++p)
+                threads.emplace_back([&queue, &remaining_producers, p]() {
+                    for(auto i{static_cast<unsigned long long>(p)}; i < total_pushs; i += producers)
+                        queue.push(i);
+                    if(remaining_producers.fetch_sub(1) == 1)
+                        queue.close();
+                });
+        }
+        check("concurrent SUM(popped elements)", sums[0] + sums[1], total_pushs * (total_pushs - 1) / 2);
+        check("concurrent allocated segments within the cap", queue.allocated_segments() <= 16 / segment_size + 1, true);
+    }
+    if(check.all_passed()) {
+        scout << "### SegmentedQueue Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> SegmentedQueue Test FAILED <<<\n";
+    return 1;
+}
@@ -0,0 +1,71 @@
+
+
+#include "../include/spin_lock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <syncstream>
+#include <thread>
+#include <vector>
+template<class Lock>
+auto contend(unsigned threads, std::uint64_t increments_per_thread)
+{
+    auto lock = Lock{};
+    auto counter{0ull};
+    auto start = std::chrono::steady_clock::now();
+    {
+        auto workers = std::vector<std::jthread>();
+        for(auto t{0u}; t < threads; ++t)
+            workers.emplace_back([&lock, &counter, increments_per_thread]() {
+                for(auto i{0ull}; i < increments_per_thread; ++i) {
+                    std::lock_guard guard{lock};
+                    ++counter;
+                }
+            });
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::pair{counter, std::chrono::duration<double>(end - start).count()};
+}
+auto main() -> int
+{
+    constexpr auto total_increments = 400'000ull;
+    auto scout{std::osyncstream{std::cout}};
+    // up to the core count the FIFO locks hand over to spinning waiters,
+    // past it oversubscribed waiters take the parking path
+    auto thn = std::max(1u, std::thread::hardware_concurrency());
+    const auto max_threads = std::max(4u, 2 * thn);
+    auto thread_counts = std::vector<unsigned>{thn};
+    for(auto n{1u}; n < max_threads; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(max_threads);
+    std::ranges::sort(thread_counts);
+    thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+    auto all_passed = true;
+    auto run = [&](const std::string& name, auto lock_tag) {
+        using Lock = typename decltype(lock_tag)::type;
+        scout << std::left << std::setw(12) << name;
+        for(auto threads : thread_counts) {
+            const auto per_thread = total_increments / threads;
+            auto [counter, seconds] = contend<Lock>(threads, per_thread);
+            all_passed = all_passed && counter == per_thread * threads;
+            scout << " | " << std::setw(3) << threads << "th " << std::fixed << std::setprecision(1)
+                  << std::setw(7) << counter / seconds / 1e6 << " Mops/s";
+        }
+        scout << '\n';
+    };
+    scout << "available threads: { " << thn << " }, increments per run: { " << total_increments << " }\n";
+    run("std::mutex", std::type_identity<std::mutex>{});
+    run("spin_lock", std::type_identity<spin_lock>{});
+    run("ticket_lock", std::type_identity<ticket_lock>{});
+    run("mcs_lock", std::type_identity<mcs_lock>{});
+    if(all_passed) {
+        scout << "### Lock Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Lock Test FAILED <<<\n";
+    return 1;
+}
@@ -0,0 +1,77 @@
+
+
+#include "../include/topology.h"
+#include "test_check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <syncstream>
+#include <thread>
+#include <vector>
+auto main() -> int
+{
+    auto scout{std::osyncstream{std::cout}};
+    auto check = test_check(scout);
+    using cpu_list = std::vector<unsigned>;
+    check("parse_cpu_list(\"0-3,8,10-11\")", parse_cpu_list("0-3,8,10-11\n"), cpu_list{0, 1, 2, 3, 8, 10, 11});
+    check("parse_cpu_list(\"\")", parse_cpu_list(""), cpu_list{});
+
+    // two nodes; cpus 0/1 and 2/3 are hyper-thread siblings of node 0
+    const auto root = std::filesystem::temp_directory_path() / "test-topology-sysfs";
+    std::filesystem::remove_all(root);
+    auto write = [&root](const std::string& file, const std::string& content) {
+        std::filesystem::create_directories((root / file).parent_path());
+        std::ofstream(root / file) << content << '\n';
+    };
+    write("cpu/online", "0-5");
+    write("node/online", "0-1");
+    write("node/node0/cpulist", "0-3");
+    write("node/node1/cpulist", "4-5");
+    const unsigned cores[] = {0, 0, 1, 1, 0, 1};
+    for(auto cpu{0u}; cpu < 6; ++cpu) {
+        const auto base = "cpu/cpu" + std::to_string(cpu) + "/topology/";
+        write(base + "core_id", std::to_string(cores[cpu]));
+        write(base + "physical_package_id", cpu < 4 ? "0" : "1");
+    }
+    const auto fake = CpuTopology::detect(root.string());
+    check("fake sysfs nodes", fake.nodes(), cpu_list{0, 1});
+    check("node 0 cpus, distinct cores before siblings", fake.node_cpus(0), cpu_list{0, 2, 1, 3});
+    check("node 1 cpus", fake.node_cpus(1), cpu_list{4, 5});
+    check("node_of_cpu(5)", fake.node_of_cpu(5), 1u);
+
+    // no node directory: a single node 0 holding every online cpu
+    std::filesystem::remove_all(root / "node");
+    const auto flat = CpuTopology::detect(root.string());
+    check("without NUMA sysfs, single node", flat.nodes(), cpu_list{0});
+    check("without NUMA sysfs, all cpus on node 0", flat.node_cpus(0).size(), std::size_t{6});
+    std::filesystem::remove_all(root);
+    const auto empty = CpuTopology::detect(root.string());
+    check("without sysfs, hardware_concurrency cpus", empty.cpus().size(),
+          static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency())));
+
+    // spawned threads are pinned before their function runs
+    const auto topology = CpuTopology::detect();
+    auto placement = NodePlacement(topology, topology.nodes().front());
+    const auto expected_cpu = placement.cpus().front();
+    auto affinity = cpu_list{};
+    placement
+        .spawn([&affinity]() {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+            for(auto cpu{0u}; cpu < CPU_SETSIZE; ++cpu)
+                if(CPU_ISSET(cpu, &set))
+                    affinity.push_back(cpu);
+        })
+        .join();
+    check("spawned thread pinned to cpu " + std::to_string(expected_cpu), affinity, cpu_list{expected_cpu});
+
+    if(check.all_passed()) {
+        scout << "### Topology Test PASSED ###\n";
+        return 0;
+    }
+    scout << ">>> Topology Test FAILED <<<\n";
+    return 1;
+}
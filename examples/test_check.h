@@ -0,0 +1,33 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <ostream>
+#include <string>
+
+// Prints one "Actuall: { what } => ..." line per comparison and remembers
+// whether all of them passed, for the test's PASSED/FAILED summary:
+//
+//   auto check = test_check(scout);
+//   check("records read", records, 200'000ull);
+//   if(check.all_passed()) ...
+class test_check
+{
+    std::ostream& out;
+    bool passed_so_far{true};
+
+  public:
+    explicit test_check(std::ostream& os) : out(os) {}
+
+    template<class Actual, class Expected>
+    bool operator()(const std::string& what, const Actual& actual, const Expected& expected)
+    {
+        const bool passed = actual == expected;
+        passed_so_far = passed_so_far && passed;
+        out << "Actuall: { " << what << " }" << (passed ? " => as Expected" : " => Failed") << '\n';
+        return passed;
+    }
+
+    bool all_passed() const noexcept { return passed_so_far; }
+};
+
+#endif // TEST_CHECK_H
@@ -2,6 +2,7 @@
 #define CHUNK_EXTRACTOR_H
 
 #include "Record.h"
+#include "RecordFilter.h"
 
 #include <climits>
 #include <cstring>
@@ -10,6 +11,7 @@
 #include <iostream>
 #include <sstream>
 #include <streambuf>
+#include <string_view>
 
 constexpr inline std::size_t DEFAULT_BUFFER_SIZE = 655360UL;
 enum FileType : unsigned int;
@@ -34,19 +36,11 @@ class ParsingInputStreambuf : public std::basic_streambuf<El, Tr>
     std::streambuf* m_Source;
     Extractor m_Extractor;
     char_type m_Buffer[CHUNK_SIZE];
+    LineFilter m_Filter;
 
-  public:
-    explicit ParsingInputStreambuf(istream_reference istrm, std::string streamId,
-                                   FileType strmType)
-        : m_Source(istrm.rdbuf()), m_Extractor(streamId, strmType)
-    {
-        m_Source->pubsetbuf(0, 0);
-        char_type* ptr = &m_Buffer[0];
-        this->setg(ptr, ptr, ptr);
-    }
-    virtual ~ParsingInputStreambuf(){};
-
-    ExtractedType extract()
+    // locates the next line in the buffer, refilling it as needed;
+    // returns false once the source is exhausted
+    bool nextLine(const char_type*& line, std::streamsize& length)
     {
         // this will cause buffer fill
         auto* curr = this->gptr();
@@ -56,7 +50,11 @@ class ParsingInputStreambuf : public std::basic_streambuf<El, Tr>
         char* ptr = &m_Buffer[0];
 
         if(begin == end) {
-            underflow(); //<--- yep
+            if(underflow() == traits_type::eof()) { //<--- yep
+                line = curr;
+                length = 0;
+                return false;
+            }
             curr = this->gptr();
             begin = curr;
             end = this->egptr();
@@ -70,12 +68,15 @@ class ParsingInputStreambuf : public std::basic_streambuf<El, Tr>
             }
             if(ch == '\n' || ch == traits_type::eof()) {
                 this->setg(ptr, ++curr, end);
-                return m_Extractor(begin, curr - begin - 2);
+                line = begin;
+                length = std::max<std::streamsize>(curr - begin - 2, 0);
+                return true;
             }
             if(curr < fixend) {
                 this->setg(ptr, curr, curr);
-                ;
-                return m_Extractor(begin, curr - begin);
+                line = begin;
+                length = curr - begin;
+                return true;
             } else {
                 ++curr;
                 memmove(ptr, begin, curr - begin - 1);
@@ -87,8 +88,51 @@ class ParsingInputStreambuf : public std::basic_streambuf<El, Tr>
             curr = end; // this->gptr();
             end = this->egptr();
         }
-        return m_Extractor(curr, 0);
+        line = curr;
+        length = 0;
+        return false;
+    }
+
+  public:
+    explicit ParsingInputStreambuf(istream_reference istrm, std::string streamId,
+                                   FileType strmType)
+        : m_Source(istrm.rdbuf()), m_Extractor(streamId, strmType)
+    {
+        m_Source->pubsetbuf(0, 0);
+        char_type* ptr = &m_Buffer[0];
+        this->setg(ptr, ptr, ptr);
     }
+    virtual ~ParsingInputStreambuf(){};
+
+    ExtractedType extract()
+    {
+        const char_type* line = this->gptr();
+        std::streamsize length = 0;
+        while(nextLine(line, length)) {
+            if(m_Filter.empty() || m_Filter(line, length))
+                return m_Extractor(line, length);
+        }
+        return m_Extractor(line, length);
+    }
+
+    // raw line without building a record; the view is valid until the
+    // next extraction from this buffer
+    bool extractLine(std::basic_string_view<char_type, traits_type>& view)
+    {
+        const char_type* line = this->gptr();
+        std::streamsize length = 0;
+        while(nextLine(line, length)) {
+            if(m_Filter.empty() || m_Filter(line, length)) {
+                view = {line, static_cast<std::size_t>(length)};
+                return true;
+            }
+        }
+        view = {};
+        return false;
+    }
+
+    void addFilter(LinePredicate predicate) { m_Filter.add(std::move(predicate)); }
+    void clearFilters() noexcept { m_Filter.clear(); }
     char* current() const { return this->gptr(); }
 
   protected:
@@ -196,6 +240,19 @@ class BasicParsingIstream
           istream_type(ParsingIstreamBaseType::rdbuf()) {}
     using ExtractedType = typename Extractor::ExtractedType;
 
+    void addFilter(LinePredicate predicate)
+    {
+        this->rdbuf()->addFilter(std::move(predicate));
+    }
+
+    bool extractLine(std::basic_string_view<El, Tr>& line)
+    {
+        if(this->rdbuf()->extractLine(line))
+            return true;
+        this->setstate(std::ios::eofbit);
+        return false;
+    }
+
     ExtractedType extract()
     {
         //  this->peek();
@@ -205,6 +262,16 @@ class BasicParsingIstream
     }
 };
 
+// Readers are drained with `while(reader.good()) reader.getRecord();`.
+// good() turns false together with the last line of the input, so an empty
+// input, or one whose remaining lines are all rejected by a filter, yields
+// a single invalid record at the end.
+//
+// Line endings: FileParser drops the last two bytes of every line, which
+// fits CRLF input; LF-only input loses the last character of each line
+// ("abc,10,12\n" parses with price 1). PooledFileParser and
+// DirectFileParser strip the '\n' and an optional '\r', so they read both
+// correctly.
 template<class RecordType>
 struct IFileReader
 {
@@ -236,6 +303,9 @@ class FileParser : public IFileReader<typename Extractor::ExtractedType>
           m_inputFileStream(),
           m_ParserStream(m_inputFileStream, m_readerId, m_streamType)
     {
+        // process-wide, and its effect is implementation-defined once the
+        // standard streams have been used: programs that print should turn
+        // the sync off themselves before their first output
         std::ios_base::sync_with_stdio(false);
         m_inputFileStream.open(fname, std::ios::in | std::ios::binary);
     }
@@ -261,10 +331,23 @@ class FileParser : public IFileReader<typename Extractor::ExtractedType>
 
     virtual std::string getId() const override { return m_readerId; }
 
+    // lines rejected by a filter are skipped before any Record is built
+    FileParser& addFilter(LinePredicate predicate)
+    {
+        m_ParserStream.addFilter(std::move(predicate));
+        return *this;
+    }
+
     virtual ExtractedType getRecord() override
     {
         return m_ParserStream.extract();
     }
+
+    // false once the file is exhausted; see ParsingInputStreambuf::extractLine
+    bool getLine(std::basic_string_view<El, Tr>& line)
+    {
+        return m_ParserStream.extractLine(line);
+    }
 };
 using RecordParser =
     FileParser<Record,
@@ -0,0 +1,326 @@
+#ifndef DIRECT_FILE_PARSER_H
+#define DIRECT_FILE_PARSER_H
+
+#include "ChunkExtractor.h"
+#include "RecordFilter.h"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <fcntl.h>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Cold one-pass scans that bypass the page cache: the file is opened with
+// O_DIRECT and read in aligned chunks by `depth` io threads, so up to
+// `depth` reads are in flight while the consumer parses the oldest chunk.
+// Filesystems refusing O_DIRECT (tmpfs, some network mounts) fall back to
+// buffered reads with POSIX_FADV_NOREUSE.
+
+struct DirectReadOptions
+{
+    std::size_t chunkSize{DEFAULT_BUFFER_SIZE};
+    std::size_t depth{4};
+    bool hugePages{false};
+};
+
+// page aligned io buffer; MAP_HUGETLB when requested and available,
+// otherwise transparent huge pages are advised
+class AlignedBuffer
+{
+    char* m_data{nullptr};
+    std::size_t m_size{0};
+
+  public:
+    static constexpr std::size_t alignment = 4096;
+    static constexpr std::size_t huge_page_size = 2UL << 20;
+
+    AlignedBuffer() = default;
+    AlignedBuffer(std::size_t size, bool hugePages)
+    {
+        void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if(hugePages) {
+            m_size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+            ptr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if(ptr == MAP_FAILED) {
+            m_size = (size + alignment - 1) / alignment * alignment;
+            ptr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(ptr == MAP_FAILED)
+                throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+            if(hugePages)
+                madvise(ptr, m_size, MADV_HUGEPAGE);
+#endif
+        }
+        m_data = static_cast<char*>(ptr);
+    }
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+    ~AlignedBuffer()
+    {
+        if(m_data)
+            munmap(m_data, m_size);
+    }
+    char* data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+};
+
+template<class Extractor>
+class DirectFileParser : public IFileReader<typename Extractor::ExtractedType>
+{
+  public:
+    using ExtractedType = typename Extractor::ExtractedType;
+
+  private:
+    enum class SlotState { empty, ready, failed };
+    struct Slot
+    {
+        AlignedBuffer buffer;
+        std::size_t size{0};
+        SlotState state{SlotState::empty};
+        int error{0};
+    };
+
+    std::string m_path;
+    std::string m_readerId;
+    Extractor m_Extractor;
+    LineFilter m_Filter;
+    int m_fd{-1};
+    int m_bufferedFd{-1};
+    bool m_direct{true};
+    std::size_t m_chunkSize;
+    std::size_t m_chunkCount{0};
+    std::vector<Slot> m_slots;
+    std::vector<std::thread> m_readers;
+    std::mutex m_mutex;
+    std::condition_variable m_slotChanged;
+    bool m_stop{false};
+
+    // consumer side
+    std::size_t m_chunk{0};
+    bool m_holding{false};
+    std::string_view m_data{};
+    std::string m_carry;
+    std::string m_line;
+    bool m_eof{false};
+    bool m_good{true};
+
+    ssize_t readAt(int fd, char* buffer, std::size_t count, off_t offset)
+    {
+        ssize_t result = 0;
+        do {
+            result = ::pread(fd, buffer, count, offset);
+        } while(result < 0 && errno == EINTR);
+        return result;
+    }
+
+    void readerLoop(std::size_t slotIndex)
+    {
+        auto& slot = m_slots[slotIndex];
+        for(auto chunk = slotIndex; chunk < m_chunkCount; chunk += m_slots.size()) {
+            {
+                std::unique_lock lock{m_mutex};
+                m_slotChanged.wait(lock, [&] { return m_stop || slot.state == SlotState::empty; });
+                if(m_stop)
+                    return;
+            }
+            const auto offset = static_cast<off_t>(chunk * m_chunkSize);
+            auto count = readAt(m_fd, slot.buffer.data(), m_chunkSize, offset);
+            // some filesystems reject the unaligned tail of the file with
+            // EINVAL; read it through the buffered descriptor instead
+            if(count < 0 && errno == EINVAL && m_direct)
+                count = readAt(m_bufferedFd, slot.buffer.data(), m_chunkSize, offset);
+            {
+                std::lock_guard lock{m_mutex};
+                if(count < 0) {
+                    slot.error = errno;
+                    slot.state = SlotState::failed;
+                } else {
+                    slot.size = static_cast<std::size_t>(count);
+                    slot.state = SlotState::ready;
+                }
+            }
+            m_slotChanged.notify_all();
+        }
+    }
+
+    bool acquireChunk()
+    {
+        if(m_chunk >= m_chunkCount)
+            return false;
+        auto& slot = m_slots[m_chunk % m_slots.size()];
+        std::unique_lock lock{m_mutex};
+        m_slotChanged.wait(lock, [&] { return slot.state != SlotState::empty; });
+        if(slot.state == SlotState::failed) {
+            m_good = false;
+            throw std::system_error(slot.error, std::generic_category(), m_path);
+        }
+        m_data = {slot.buffer.data(), slot.size};
+        m_holding = true;
+        return true;
+    }
+
+    void releaseChunk()
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            m_slots[m_chunk % m_slots.size()].state = SlotState::empty;
+        }
+        m_slotChanged.notify_all();
+        m_holding = false;
+        m_data = {};
+        ++m_chunk;
+    }
+
+    // like FileParser's peek(): reaches the end of the stream as soon as
+    // no byte is left after the line just returned
+    void peek()
+    {
+        while(!m_eof) {
+            if(m_holding && !m_data.empty())
+                return;
+            if(m_holding)
+                releaseChunk();
+            if(!acquireChunk()) {
+                m_eof = m_carry.empty();
+                return;
+            }
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stop = true;
+        }
+        m_slotChanged.notify_all();
+        for(auto& reader : m_readers)
+            if(reader.joinable())
+                reader.join();
+        if(m_fd >= 0 && m_fd != m_bufferedFd)
+            ::close(m_fd);
+        if(m_bufferedFd >= 0)
+            ::close(m_bufferedFd);
+    }
+
+  public:
+    DirectFileParser(std::string fname, std::string Id, FileType strmType, DirectReadOptions options = {})
+        : m_path(std::move(fname)),
+          m_readerId(std::move(Id)),
+          m_Extractor(m_readerId, strmType),
+          m_chunkSize((std::max(options.chunkSize, AlignedBuffer::alignment) + AlignedBuffer::alignment - 1) /
+                      AlignedBuffer::alignment * AlignedBuffer::alignment)
+    {
+        m_bufferedFd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(m_bufferedFd < 0)
+            throw std::system_error(errno, std::generic_category(), m_path);
+        m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        if(m_fd < 0) {
+            m_fd = m_bufferedFd;
+            m_direct = false;
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_NOREUSE);
+        }
+        struct stat info {};
+        if(::fstat(m_fd, &info) < 0) {
+            const auto error = errno;
+            stop();
+            throw std::system_error(error, std::generic_category(), m_path);
+        }
+        const auto fileSize = static_cast<std::size_t>(info.st_size);
+        m_chunkCount = (fileSize + m_chunkSize - 1) / m_chunkSize;
+        const auto depth = std::max<std::size_t>(1, std::min(options.depth, std::max<std::size_t>(m_chunkCount, 1)));
+        m_slots.resize(depth);
+        for(auto& slot : m_slots)
+            slot.buffer = AlignedBuffer(m_chunkSize, options.hugePages);
+        for(std::size_t i = 0; i < depth; ++i)
+            m_readers.emplace_back(&DirectFileParser::readerLoop, this, i);
+    }
+
+    DirectFileParser(const DirectFileParser&) = delete;
+    DirectFileParser& operator=(const DirectFileParser&) = delete;
+    ~DirectFileParser() { stop(); }
+
+    bool direct() const noexcept { return m_direct; }
+
+    DirectFileParser& addFilter(LinePredicate predicate)
+    {
+        m_Filter.add(std::move(predicate));
+        return *this;
+    }
+
+    // next accepted line without its CR/LF ending; the view is valid until
+    // the next call
+    bool getLine(std::string_view& line)
+    {
+        while(!m_eof) {
+            if(!m_holding && !acquireChunk()) {
+                m_eof = true;
+                if(m_carry.empty())
+                    break;
+                m_line.swap(m_carry);
+                m_carry.clear();
+                line = m_line;
+            } else {
+                const auto newline = m_data.find('\n');
+                if(newline == std::string_view::npos) {
+                    m_carry.append(m_data);
+                    releaseChunk();
+                    continue;
+                }
+                line = m_data.substr(0, newline);
+                m_data.remove_prefix(newline + 1);
+                if(!m_carry.empty()) {
+                    m_carry.append(line);
+                    m_line.swap(m_carry);
+                    m_carry.clear();
+                    line = m_line;
+                }
+            }
+            if(!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            if(m_Filter.empty() || m_Filter(line.data(), static_cast<std::streamsize>(line.size())))
+                return true;
+        }
+        line = {};
+        return false;
+    }
+
+    virtual ExtractedType getRecord() override
+    {
+        std::string_view line;
+        getLine(line);
+        auto record = m_Extractor(line.data(), static_cast<std::streamsize>(line.size()));
+        peek();
+        return record;
+    }
+
+    virtual bool eof() const override { return m_eof; }
+    virtual bool good() const override { return m_good && !m_eof; }
+    virtual std::string getId() const override { return m_readerId; }
+};
+
+using DirectRecordParser =
+    DirectFileParser<RecordExtractFunctor<Record*, char, std::char_traits<char>, DEFAULT_BUFFER_SIZE>>;
+
+#endif // DIRECT_FILE_PARSER_H
@@ -0,0 +1,397 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include "ChunkExtractor.h"
+#include "Record.h"
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Sorts Records by id, then price, with bounded memory. Records are packed
+// into run buffers; each full buffer is sorted and spilled to a temporary
+// file on a worker thread while the next one fills, and merge() streams the
+// runs back through a k-way merge. Sorting compares an 8-byte big-endian id
+// prefix held in the entry itself, so most comparisons never touch the id
+// bytes. Inputs that fit in one run never leave memory.
+//
+//   ExternalSorter sorter({.memoryBudget = 1ul << 30});
+//   sorter.consume(parser);                       // or sorter.consume(ring)
+//   sorter.merge([&](Record* record) { ring.push(record); });
+
+struct ExternalSortOptions
+{
+    // split between the run being filled and the `parallelism` runs being
+    // sorted (each with its spill buffer), then between the merge buffers;
+    // budgets below a few hundred KiB are rounded up
+    std::size_t memoryBudget{256UL << 20};
+    std::size_t parallelism{std::max(1u, std::thread::hardware_concurrency())};
+    std::filesystem::path tempDirectory{std::filesystem::temp_directory_path()};
+};
+
+class ExternalSorter
+{
+    struct Entry
+    {
+        std::uint64_t prefix;
+        double price;
+        std::int32_t quantity;
+        std::uint32_t idOffset;
+        std::uint16_t idLength;
+        std::uint16_t stream;
+    };
+
+    // allocated once at its full size (see reserve()) and never grown, so a
+    // run holds exactly the run budget
+    struct Run
+    {
+        std::vector<Entry> entries;
+        std::string ids;
+
+        void reserve(std::size_t bytes)
+        {
+            // ids of up to 16 bytes: a third for the id bytes
+            entries.reserve(std::max<std::size_t>(1, bytes / 3 * 2 / sizeof(Entry)));
+            ids.reserve(bytes / 3);
+        }
+        bool fits(std::size_t idLength) const noexcept
+        {
+            return entries.size() < entries.capacity() && ids.size() + idLength <= ids.capacity();
+        }
+        std::string_view id(const Entry& entry) const noexcept
+        {
+            return {ids.data() + entry.idOffset, entry.idLength};
+        }
+    };
+
+    // one spilled record: [u16 id length][id][f64 price][i32 quantity][u16 stream]
+    struct RunReader
+    {
+        std::ifstream file;
+        std::vector<char> buffer;
+        std::string id;
+        double price{0};
+        std::int32_t quantity{0};
+        std::uint16_t stream{0};
+
+        RunReader(const std::filesystem::path& path, std::size_t bufferSize) : buffer(bufferSize)
+        {
+            file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            file.open(path, std::ios::in | std::ios::binary);
+            if(!file)
+                throw std::runtime_error("cannot open sort run " + path.string());
+        }
+
+        bool next()
+        {
+            std::uint16_t length = 0;
+            if(!file.read(reinterpret_cast<char*>(&length), sizeof(length)))
+                return false;
+            id.resize(length);
+            file.read(id.data(), length);
+            file.read(reinterpret_cast<char*>(&price), sizeof(price));
+            file.read(reinterpret_cast<char*>(&quantity), sizeof(quantity));
+            file.read(reinterpret_cast<char*>(&stream), sizeof(stream));
+            if(!file)
+                throw std::runtime_error("truncated sort run");
+            return true;
+        }
+    };
+
+    static constexpr std::size_t min_merge_buffer = 64UL << 10;
+    static constexpr std::size_t max_spill_buffer = 1UL << 20;
+    static constexpr std::size_t max_fan_in = 512;
+
+    ExternalSortOptions m_options;
+    std::size_t m_runBudget;
+    std::size_t m_spillBuffer;
+    Run m_current;
+    std::deque<std::future<std::filesystem::path>> m_pending;
+    std::vector<std::filesystem::path> m_runs;
+    std::vector<std::string> m_streams;
+    std::unordered_map<std::string, std::uint16_t> m_streamIndex;
+    std::size_t m_nextRun{0};
+
+    static std::uint64_t keyPrefix(std::string_view id) noexcept
+    {
+        std::uint64_t prefix = 0;
+        for(std::size_t i = 0; i < sizeof(prefix); ++i)
+            prefix = (prefix << 8) | (i < id.size() ? static_cast<unsigned char>(id[i]) : 0u);
+        return prefix;
+    }
+
+    static bool less(std::string_view lhsId, double lhsPrice, std::string_view rhsId, double rhsPrice) noexcept
+    {
+        const auto order = lhsId.compare(rhsId);
+        return order != 0 ? order < 0 : lhsPrice < rhsPrice;
+    }
+
+    static void sortRun(Run& run)
+    {
+        std::sort(run.entries.begin(), run.entries.end(), [&run](const Entry& lhs, const Entry& rhs) {
+            if(lhs.prefix != rhs.prefix)
+                return lhs.prefix < rhs.prefix;
+            return less(run.id(lhs), lhs.price, run.id(rhs), rhs.price);
+        });
+    }
+
+    static void write(std::ofstream& file, std::string_view id, double price, std::int32_t quantity,
+                      std::uint16_t stream)
+    {
+        const auto length = static_cast<std::uint16_t>(id.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(id.data(), length);
+        file.write(reinterpret_cast<const char*>(&price), sizeof(price));
+        file.write(reinterpret_cast<const char*>(&quantity), sizeof(quantity));
+        file.write(reinterpret_cast<const char*>(&stream), sizeof(stream));
+    }
+
+    std::filesystem::path nextRunPath()
+    {
+        return m_options.tempDirectory /
+               ("fiosync-sort-" + std::to_string(::getpid()) + "-" +
+                std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "-" + std::to_string(m_nextRun++) + ".run");
+    }
+
+    static std::filesystem::path spill(Run run, std::filesystem::path path, std::size_t bufferSize)
+    {
+        sortRun(run);
+        std::vector<char> buffer(bufferSize);
+        std::ofstream file;
+        file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        for(const auto& entry : run.entries)
+            write(file, run.id(entry), entry.price, entry.quantity, entry.stream);
+        file.close();
+        if(!file)
+            throw std::runtime_error("cannot write sort run " + path.string());
+        return path;
+    }
+
+    void flushRun()
+    {
+        if(m_current.entries.empty())
+            return;
+        // keep at most `parallelism` runs sorting while the next one fills
+        while(m_pending.size() >= m_options.parallelism)
+            collectOldest();
+        m_pending.push_back(
+            std::async(std::launch::async, &ExternalSorter::spill, std::move(m_current), nextRunPath(), m_spillBuffer));
+        m_current = Run{};
+    }
+
+    void collectOldest()
+    {
+        auto future = std::move(m_pending.front());
+        m_pending.pop_front();
+        m_runs.push_back(future.get());
+    }
+
+    std::uint16_t streamIndex(const std::string& streamId)
+    {
+        auto found = m_streamIndex.find(streamId);
+        if(found != m_streamIndex.end())
+            return found->second;
+        if(m_streams.size() > std::numeric_limits<std::uint16_t>::max())
+            throw std::length_error("too many input streams to sort");
+        const auto index = static_cast<std::uint16_t>(m_streams.size());
+        m_streams.push_back(streamId);
+        m_streamIndex.emplace(streamId, index);
+        return index;
+    }
+
+    // merge buffers share the budget; a sixteenth is kept for the streams,
+    // paths and heap of the merge itself
+    std::size_t mergeBudget() const noexcept { return m_options.memoryBudget - m_options.memoryBudget / 16; }
+
+    // runs merged in one pass: every reader and the writer get a
+    // min_merge_buffer or more, and every reader holds a descriptor, so at
+    // most half of the soft RLIMIT_NOFILE is used
+    std::size_t mergeFanIn() const noexcept
+    {
+        auto limit = std::min(max_fan_in, std::max<std::size_t>(3, mergeBudget() / min_merge_buffer) - 1);
+        rlimit files{};
+        if(::getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur != RLIM_INFINITY)
+            limit = std::min<std::size_t>(limit, files.rlim_cur / 2);
+        return std::max<std::size_t>(2, limit);
+    }
+
+    // one share of the merge budget per merged run plus one for the output
+    std::size_t mergeBuffer(std::size_t runCount) const noexcept
+    {
+        return std::max(min_merge_buffer, mergeBudget() / (runCount + 1));
+    }
+
+    // merges `runs` in one pass, calling emit(id, price, quantity, stream)
+    template<class Emit>
+    void mergeRuns(const std::vector<std::filesystem::path>& runs, Emit&& emit)
+    {
+        const auto bufferSize = mergeBuffer(runs.size());
+        std::vector<std::unique_ptr<RunReader>> readers;
+        for(const auto& run : runs)
+            readers.push_back(std::make_unique<RunReader>(run, bufferSize));
+        auto greater = [&readers](std::size_t lhs, std::size_t rhs) {
+            return less(readers[rhs]->id, readers[rhs]->price, readers[lhs]->id, readers[lhs]->price);
+        };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heads(greater);
+        for(std::size_t i = 0; i < readers.size(); ++i)
+            if(readers[i]->next())
+                heads.push(i);
+        while(!heads.empty()) {
+            const auto top = heads.top();
+            heads.pop();
+            auto& reader = *readers[top];
+            emit(std::string_view{reader.id}, reader.price, reader.quantity, reader.stream);
+            if(reader.next())
+                heads.push(top);
+        }
+    }
+
+    void removeRuns(const std::vector<std::filesystem::path>& runs)
+    {
+        std::error_code ignored;
+        for(const auto& run : runs)
+            std::filesystem::remove(run, ignored);
+    }
+
+  public:
+    explicit ExternalSorter(ExternalSortOptions options = {}) : m_options(std::move(options))
+    {
+        m_options.parallelism = std::max<std::size_t>(1, m_options.parallelism);
+        // one share per run in memory: the one filling and those sorting;
+        // a sorting run also holds its spill buffer
+        const auto share = std::max(2 * min_merge_buffer, m_options.memoryBudget / (m_options.parallelism + 1));
+        m_spillBuffer = std::clamp(share / 8, std::size_t{4096}, max_spill_buffer);
+        m_runBudget = share - m_spillBuffer;
+    }
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    ~ExternalSorter()
+    {
+        for(auto& pending : m_pending) {
+            try {
+                m_runs.push_back(pending.get());
+            } catch(...) {
+            }
+        }
+        removeRuns(m_runs);
+    }
+
+    // copies the record into the current run; invalid records are dropped
+    void add(const Record& record)
+    {
+        const auto& id = record.getId();
+        if(id.size() > std::numeric_limits<std::uint16_t>::max())
+            throw std::length_error("record id too long to sort");
+        if(!m_current.fits(id.size()) || m_current.ids.size() + id.size() > std::numeric_limits<std::uint32_t>::max())
+            flushRun();
+        if(m_current.entries.capacity() == 0)
+            m_current.reserve(m_runBudget);
+        Entry entry{keyPrefix(id), record.getPrice(), record.getQuantity(),
+                    static_cast<std::uint32_t>(m_current.ids.size()), static_cast<std::uint16_t>(id.size()),
+                    streamIndex(record.getSourceStreamId())};
+        m_current.ids.append(id);
+        m_current.entries.push_back(entry);
+    }
+
+    // takes ownership of records produced by a FileParser
+    template<class Reader>
+    void consume(Reader& reader)
+    {
+        while(reader.good()) {
+            std::unique_ptr<Record> record{reader.getRecord()};
+            if(record && record->Valid())
+                add(*record);
+        }
+    }
+
+    // drains a RingBuffer of owned records until it is closed
+    template<class Allocator>
+    void consume(RingBuffer<Record*, Allocator>& ring)
+    {
+        for(;;) {
+            Record* popped = nullptr;
+            try {
+                popped = ring.pop();
+            } catch(const std::runtime_error&) {
+                return; // closed and drained
+            }
+            std::unique_ptr<Record> record{popped};
+            if(record && record->Valid())
+                add(*record);
+        }
+    }
+
+    // Emits every added record in (id, price) order as a new Record owned by
+    // the sink. Runs beyond what the memory budget can merge at once are
+    // merged in intermediate passes first.
+    template<class Sink>
+    void merge(Sink&& sink)
+    {
+        auto emit = [this, &sink](std::string_view id, double price, std::int32_t quantity, std::uint16_t stream) {
+            sink(new Record(std::string(id), quantity, price, m_streams[stream]));
+        };
+        if(m_runs.empty() && m_pending.empty()) {
+            sortRun(m_current);
+            for(const auto& entry : m_current.entries)
+                emit(m_current.id(entry), entry.price, entry.quantity, entry.stream);
+            m_current = Run{};
+            return;
+        }
+        flushRun();
+        while(!m_pending.empty())
+            collectOldest();
+
+        const auto fanIn = mergeFanIn();
+        while(m_runs.size() > fanIn) {
+            std::vector<std::filesystem::path> batch(m_runs.begin(), m_runs.begin() + static_cast<std::ptrdiff_t>(fanIn));
+            auto merged = nextRunPath();
+            {
+                std::vector<char> buffer(mergeBuffer(batch.size()));
+                std::ofstream file;
+                file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                file.open(merged, std::ios::out | std::ios::binary | std::ios::trunc);
+                mergeRuns(batch, [&file](std::string_view id, double price, std::int32_t quantity, std::uint16_t stream) {
+                    write(file, id, price, quantity, stream);
+                });
+                file.close();
+                if(!file)
+                    throw std::runtime_error("cannot write sort run " + merged.string());
+            }
+            removeRuns(batch);
+            m_runs.erase(m_runs.begin(), m_runs.begin() + static_cast<std::ptrdiff_t>(fanIn));
+            m_runs.push_back(merged);
+        }
+        mergeRuns(m_runs, emit);
+        removeRuns(m_runs);
+        m_runs.clear();
+    }
+
+    std::size_t spilledRuns() const noexcept { return m_runs.size() + m_pending.size(); }
+    std::size_t runBudget() const noexcept { return m_runBudget; }
+    std::size_t spillBufferSize() const noexcept { return m_spillBuffer; }
+};
+
+#endif // EXTERNAL_SORT_H
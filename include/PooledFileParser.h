@@ -0,0 +1,482 @@
+#ifndef POOLED_FILE_PARSER_H
+#define POOLED_FILE_PARSER_H
+
+#include "ChunkExtractor.h"
+#include "RecordFilter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Reading thousands of feeds at once: a FileParser keeps a CHUNK_SIZE
+// buffer and an open ifstream for its whole lifetime. A PooledFileParser
+// keeps only its file offset. It leases a chunk from a shared BufferPool
+// and a descriptor from a FileHandleCache for the duration of one read
+// turn, and a ReaderScheduler rotates many readers over a few threads.
+
+// fixed set of equally sized chunks, allocated once
+class BufferPool
+{
+    std::size_t m_chunkSize;
+    std::vector<char> m_storage;
+    std::vector<char*> m_free;
+    std::mutex m_mutex;
+    std::condition_variable m_available;
+
+  public:
+    class Lease
+    {
+        BufferPool* m_pool{nullptr};
+        char* m_chunk{nullptr};
+
+      public:
+        Lease() = default;
+        Lease(BufferPool* pool, char* chunk) : m_pool(pool), m_chunk(chunk) {}
+        Lease(Lease&& other) noexcept
+            : m_pool(std::exchange(other.m_pool, nullptr)), m_chunk(std::exchange(other.m_chunk, nullptr)) {}
+        Lease& operator=(Lease&& other) noexcept
+        {
+            std::swap(m_pool, other.m_pool);
+            std::swap(m_chunk, other.m_chunk);
+            return *this;
+        }
+        ~Lease()
+        {
+            if(m_pool)
+                m_pool->release(m_chunk);
+        }
+        char* data() const noexcept { return m_chunk; }
+        std::size_t size() const noexcept { return m_pool ? m_pool->chunkSize() : 0; }
+        explicit operator bool() const noexcept { return m_chunk != nullptr; }
+    };
+
+    BufferPool(std::size_t chunkCount, std::size_t chunkSize = DEFAULT_BUFFER_SIZE)
+        : m_chunkSize(chunkSize), m_storage(chunkCount * chunkSize)
+    {
+        if(chunkCount == 0 || chunkSize == 0)
+            throw std::invalid_argument("empty buffer pool");
+        for(std::size_t i = 0; i < chunkCount; ++i)
+            m_free.push_back(m_storage.data() + i * chunkSize);
+    }
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    std::size_t chunkSize() const noexcept { return m_chunkSize; }
+
+    // blocks until a chunk is returned to the pool
+    Lease lease()
+    {
+        std::unique_lock lock{m_mutex};
+        m_available.wait(lock, [this] { return !m_free.empty(); });
+        auto* chunk = m_free.back();
+        m_free.pop_back();
+        return {this, chunk};
+    }
+
+    Lease tryLease()
+    {
+        std::lock_guard lock{m_mutex};
+        if(m_free.empty())
+            return {};
+        auto* chunk = m_free.back();
+        m_free.pop_back();
+        return {this, chunk};
+    }
+
+  private:
+    void release(char* chunk)
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            m_free.push_back(chunk);
+        }
+        m_available.notify_one();
+    }
+};
+
+// Opens descriptors on demand and keeps at most `capacity` of them open,
+// closing the least recently used one that is not currently in use.
+class FileHandleCache
+{
+    struct Entry
+    {
+        std::string path;
+        int fd{-1};
+        std::size_t users{0};
+    };
+
+    std::size_t m_capacity;
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+
+    bool evictOne()
+    {
+        for(auto it = m_entries.rbegin(); it != m_entries.rend(); ++it) {
+            if(it->users == 0) {
+                ::close(it->fd);
+                m_index.erase(it->path);
+                m_entries.erase(std::next(it).base());
+                return true;
+            }
+        }
+        return false;
+    }
+
+  public:
+    class Handle
+    {
+        FileHandleCache* m_cache{nullptr};
+        std::list<Entry>::iterator m_entry{};
+
+      public:
+        Handle() = default;
+        Handle(FileHandleCache* cache, std::list<Entry>::iterator entry) : m_cache(cache), m_entry(entry) {}
+        Handle(Handle&& other) noexcept : m_cache(std::exchange(other.m_cache, nullptr)), m_entry(other.m_entry) {}
+        Handle& operator=(Handle&&) = delete;
+        ~Handle()
+        {
+            if(m_cache)
+                m_cache->release(m_entry);
+        }
+        int fd() const noexcept { return m_entry->fd; }
+    };
+
+    explicit FileHandleCache(std::size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+    FileHandleCache(const FileHandleCache&) = delete;
+    FileHandleCache& operator=(const FileHandleCache&) = delete;
+    ~FileHandleCache()
+    {
+        for(auto& entry : m_entries)
+            ::close(entry.fd);
+    }
+
+    std::size_t openCount()
+    {
+        std::lock_guard lock{m_mutex};
+        return m_entries.size();
+    }
+
+    // blocks while `capacity` descriptors are all in use
+    Handle acquire(const std::string& path)
+    {
+        std::unique_lock lock{m_mutex};
+        for(;;) {
+            if(auto found = m_index.find(path); found != m_index.end()) {
+                m_entries.splice(m_entries.begin(), m_entries, found->second);
+                ++found->second->users;
+                return {this, found->second};
+            }
+            if(m_entries.size() < m_capacity || evictOne())
+                break;
+            m_released.wait(lock);
+        }
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+        m_entries.push_front({path, fd, 1});
+        m_index.emplace(path, m_entries.begin());
+        return {this, m_entries.begin()};
+    }
+
+  private:
+    void release(std::list<Entry>::iterator entry)
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            --entry->users;
+        }
+        m_released.notify_one();
+    }
+};
+
+template<class Extractor>
+class PooledFileParser : public IFileReader<typename Extractor::ExtractedType>
+{
+  public:
+    using ExtractedType = typename Extractor::ExtractedType;
+
+  private:
+    std::string m_path;
+    std::string m_readerId;
+    BufferPool& m_buffers;
+    FileHandleCache& m_files;
+    Extractor m_Extractor;
+    LineFilter m_Filter;
+    off_t m_offset{0};
+    bool m_eof{false};
+    bool m_good{true};
+    std::deque<ExtractedType> m_pending;
+    std::uint64_t m_consumedBytes{0};
+    std::uint64_t m_deliveredRecords{0};
+    std::uint64_t m_bytesRead{0};
+    bool m_rejectedTail{false}; // lines were rejected after the last record
+
+    // records getRecord() buffers per refill, so thousands of readers do
+    // not each hold a chunk worth of records
+    static constexpr std::size_t refill_batch = 64;
+
+    // a page until the first records were seen, then the expected bytes
+    // for maxRecords records plus 1/16 and one record of slack
+    std::size_t plannedReadSize(std::size_t maxRecords, std::size_t chunkSize) const noexcept
+    {
+        constexpr std::size_t page = 4096;
+        if(m_deliveredRecords == 0)
+            return std::min(page, chunkSize);
+        const auto perRecord = std::max<std::uint64_t>(1, (m_consumedBytes + m_deliveredRecords - 1) / m_deliveredRecords);
+        if(maxRecords >= chunkSize / perRecord)
+            return chunkSize;
+        const auto wanted = perRecord * maxRecords;
+        return static_cast<std::size_t>(std::min<std::uint64_t>(chunkSize, wanted + wanted / 16 + perRecord));
+    }
+
+    void fillPending()
+    {
+        while(m_pending.empty() && !m_eof && m_good)
+            readBatch(refill_batch, [this](ExtractedType record) {
+                m_pending.push_back(std::move(record));
+            });
+        // as with FileParser, lines rejected at the end of the file still
+        // cost one invalid record
+        if(m_pending.empty() && std::exchange(m_rejectedTail, false))
+            m_pending.push_back(m_Extractor("", 0));
+    }
+
+    std::size_t readAt(char* buffer, std::size_t size)
+    {
+        ssize_t readCount = 0;
+        try {
+            auto handle = m_files.acquire(m_path);
+            do {
+                readCount = ::pread(handle.fd(), buffer, size, m_offset);
+            } while(readCount < 0 && errno == EINTR);
+        } catch(const std::system_error&) {
+            m_good = false;
+            throw;
+        }
+        if(readCount < 0) {
+            m_good = false;
+            throw std::system_error(errno, std::generic_category(), m_path);
+        }
+        m_bytesRead += static_cast<std::uint64_t>(readCount);
+        return static_cast<std::size_t>(readCount);
+    }
+
+  public:
+    PooledFileParser(std::string fname, std::string Id, FileType strmType, BufferPool& buffers,
+                     FileHandleCache& files)
+        : m_path(std::move(fname)),
+          m_readerId(std::move(Id)),
+          m_buffers(buffers),
+          m_files(files),
+          m_Extractor(m_readerId, strmType) {}
+
+    PooledFileParser(const PooledFileParser&) = delete;
+    PooledFileParser& operator=(const PooledFileParser&) = delete;
+
+    PooledFileParser& addFilter(LinePredicate predicate)
+    {
+        m_Filter.add(std::move(predicate));
+        return *this;
+    }
+
+    // One read turn: leases a chunk and a descriptor, reads from the saved
+    // offset and hands at most maxRecords records to sink. The read is sized
+    // from the bytes per delivered record seen so far, so a small quantum
+    // does not pull in a whole chunk; the bytes after the last delivered
+    // line are read again on the next turn. Returns the number of records
+    // delivered.
+    template<class Sink>
+    std::size_t readBatch(std::size_t maxRecords, Sink&& sink)
+    {
+        if(m_eof || !m_good)
+            return 0;
+        auto chunk = m_buffers.lease();
+        auto readSize = plannedReadSize(maxRecords, chunk.size());
+        for(;;) {
+            const auto readCount = readAt(chunk.data(), readSize);
+            if(readCount == 0) {
+                m_eof = true;
+                return 0;
+            }
+            // a short read of a regular file ends at its end
+            const bool lastChunk = readCount < readSize;
+            std::string_view data{chunk.data(), readCount};
+            std::size_t delivered = 0;
+            std::size_t consumedBytes = 0;
+            while(delivered < maxRecords && !data.empty()) {
+                auto newline = data.find('\n');
+                // a line longer than the whole chunk is cut at the chunk end
+                if(newline == std::string_view::npos && !lastChunk &&
+                   (consumedBytes != 0 || readSize < chunk.size()))
+                    break; // incomplete line, continue from its start
+                const auto consumed = newline == std::string_view::npos ? data.size() : newline + 1;
+                auto line = data.substr(0, newline == std::string_view::npos ? data.size() : newline);
+                if(!line.empty() && line.back() == '\r')
+                    line.remove_suffix(1);
+                data.remove_prefix(consumed);
+                consumedBytes += consumed;
+                if(m_Filter.empty() || m_Filter(line.data(), static_cast<std::streamsize>(line.size()))) {
+                    sink(m_Extractor(line.data(), static_cast<std::streamsize>(line.size())));
+                    ++delivered;
+                    m_rejectedTail = false;
+                } else {
+                    m_rejectedTail = true;
+                }
+            }
+            m_offset += static_cast<off_t>(consumedBytes);
+            m_consumedBytes += consumedBytes;
+            m_deliveredRecords += delivered;
+            if(lastChunk && data.empty())
+                m_eof = true;
+            // the first line did not fit the estimate: retry with the chunk
+            if(consumedBytes == 0 && readSize < chunk.size()) {
+                readSize = chunk.size();
+                continue;
+            }
+            return delivered;
+        }
+    }
+
+    // bytes pread() so far, to compare against the file size
+    std::uint64_t bytesRead() const noexcept { return m_bytesRead; }
+
+    bool finished() const noexcept { return (m_eof || !m_good) && m_pending.empty(); }
+    std::size_t pendingRecords() const noexcept { return m_pending.size(); }
+
+    virtual bool eof() const override { return m_eof && m_pending.empty(); }
+    virtual bool good() const override { return m_good && !eof(); }
+    virtual std::string getId() const override { return m_readerId; }
+
+    // IFileReader compatibility; buffers up to refill_batch records and
+    // reads ahead so that good() turns false with the last record
+    virtual ExtractedType getRecord() override
+    {
+        fillPending();
+        if(m_pending.empty())
+            return m_Extractor("", 0);
+        auto record = std::move(m_pending.front());
+        m_pending.pop_front();
+        fillPending();
+        return record;
+    }
+};
+
+using PooledRecordParser =
+    PooledFileParser<RecordExtractFunctor<Record*, char, std::char_traits<char>, DEFAULT_BUFFER_SIZE>>;
+
+// a reader that threw during ReaderScheduler::run()
+struct ReaderFailure
+{
+    std::string readerId;
+    std::exception_ptr error;
+};
+
+// thrown by ReaderScheduler::run() once the healthy readers are drained
+class ReaderScheduleError : public std::runtime_error
+{
+    std::vector<ReaderFailure> m_failures;
+
+    static std::string describe(const std::vector<ReaderFailure>& failures)
+    {
+        auto message = std::to_string(failures.size()) + " reader(s) failed";
+        for(const auto& failure : failures) {
+            message += "; " + failure.readerId + ": ";
+            try {
+                std::rethrow_exception(failure.error);
+            } catch(const std::exception& error) {
+                message += error.what();
+            } catch(...) {
+                message += "unknown error";
+            }
+        }
+        return message;
+    }
+
+  public:
+    explicit ReaderScheduleError(std::vector<ReaderFailure> failures)
+        : std::runtime_error(describe(failures)), m_failures(std::move(failures)) {}
+    const std::vector<ReaderFailure>& failures() const noexcept { return m_failures; }
+};
+
+// Rotates through many readers fairly: every turn a worker takes the
+// reader at the front of the queue, delivers up to `quantum` records and
+// requeues it at the back until it is exhausted. A reader whose turn
+// throws (from its read or from the sink) is dropped from the rotation
+// while the others keep running; run() then throws a ReaderScheduleError
+// listing every failed reader.
+template<class Reader>
+class ReaderScheduler
+{
+    std::deque<Reader*> m_queue;
+    std::mutex m_mutex;
+    std::size_t m_quantum;
+
+  public:
+    explicit ReaderScheduler(std::size_t quantum = 1024) : m_quantum(quantum ? quantum : 1) {}
+
+    void add(Reader& reader)
+    {
+        std::lock_guard lock{m_mutex};
+        m_queue.push_back(&reader);
+    }
+
+    // sink is called concurrently from all worker threads
+    template<class Sink>
+    void run(Sink&& sink, std::size_t threadCount = 1)
+    {
+        std::vector<ReaderFailure> failures;
+        auto work = [&] {
+            for(;;) {
+                Reader* reader = nullptr;
+                {
+                    std::lock_guard lock{m_mutex};
+                    if(m_queue.empty())
+                        return;
+                    reader = m_queue.front();
+                    m_queue.pop_front();
+                }
+                try {
+                    reader->readBatch(m_quantum, sink);
+                } catch(...) {
+                    std::lock_guard lock{m_mutex};
+                    failures.push_back({reader->getId(), std::current_exception()});
+                    continue;
+                }
+                if(!reader->finished()) {
+                    std::lock_guard lock{m_mutex};
+                    m_queue.push_back(reader);
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for(std::size_t i = 1; i < threadCount; ++i)
+            threads.emplace_back(work);
+        work();
+        for(auto& thread : threads)
+            thread.join();
+        if(!failures.empty())
+            throw ReaderScheduleError(std::move(failures));
+    }
+};
+
+#endif // POOLED_FILE_PARSER_H
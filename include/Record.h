@@ -3,6 +3,8 @@
 #include <iomanip>
 #include <iostream>
 #include <algorithm>
+#include <sstream>
+#include <string>
 
 enum FileType : unsigned int { unknown, csv, json, desc};
 class Record {
@@ -15,6 +17,8 @@ class Record {
 
   inline void parse() noexcept {
     valid = false;
+    if (id.empty())
+      return;
     std::string content{id};
     if (streamType == csv) {
       std::replace(content.begin(), content.end(),',',' ');
@@ -35,6 +39,11 @@ class Record {
       : id(contentPtr, length), inputId(streamId), streamType(strmType) {
     parse();
   }
+  // already parsed fields, e.g. read back from a sort run
+  Record(std::string recordId, int recordQuantity, double recordPrice,
+         const std::string& streamId, FileType strmType = csv)
+      : price(recordPrice), quantity(recordQuantity), id(std::move(recordId)),
+        inputId(streamId), streamType(strmType), valid(true) {}
   friend std::ostream& operator<<(std::ostream& os, const Record& r) {
     if (r.inputId == "stop") {
       os.setstate(std::ios::eofbit);
@@ -45,7 +54,10 @@ class Record {
     return os;
   }
  inline bool Valid() {return valid;}
- inline std::string getSourceStreamId() { return inputId;}
+ inline std::string getSourceStreamId() const { return inputId;}
+ inline const std::string& getId() const { return id;}
+ inline int getQuantity() const { return quantity;}
+ inline double getPrice() const { return price;}
 };
 
 #endif
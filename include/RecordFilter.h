@@ -0,0 +1,145 @@
+#ifndef RECORD_FILTER_H
+#define RECORD_FILTER_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <emmintrin.h>
+#include <functional>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Predicates evaluated on the raw line span inside
+// ParsingInputStreambuf::extract(), before any Record is constructed.
+// Lines follow the csv layout parsed by Record: id,quantity,price
+using LinePredicate = std::function<bool(std::string_view)>;
+
+namespace raw_line {
+
+enum Field : std::size_t { id = 0, quantity = 1, price = 2 };
+
+constexpr inline std::size_t simd_width = sizeof(__m128i);
+
+// Compares count bytes of text against prefix, 16 at a time with SSE2.
+// A shorter tail is compared with one masked 16-byte load when text has
+// that many readable bytes, so prefix must be padded to a multiple of 16.
+inline bool equal_prefix(const char* text, std::size_t readable, const char* prefix, std::size_t count) noexcept
+{
+    for(; count >= simd_width; count -= simd_width, readable -= simd_width, text += simd_width, prefix += simd_width) {
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF)
+            return false;
+    }
+    if(count == 0)
+        return true;
+    if(readable < simd_width)
+        return std::memcmp(text, prefix, count) == 0;
+    const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+    const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix));
+    const int mask = (1 << count) - 1;
+    return (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) & mask) == mask;
+}
+
+inline std::string_view field(std::string_view line, std::size_t index) noexcept
+{
+    for(; index; --index) {
+        const auto separator = line.find(',');
+        if(separator == std::string_view::npos)
+            return {};
+        line.remove_prefix(separator + 1);
+    }
+    const auto separator = line.find(',');
+    if(separator != std::string_view::npos)
+        line = line.substr(0, separator);
+    while(!line.empty() && line.front() == ' ')
+        line.remove_prefix(1);
+    return line;
+}
+
+// the whole field must be a number, as Record requires: "12abc" is rejected
+template<class ValueType>
+bool parse(std::string_view text, ValueType& value) noexcept
+{
+    const auto* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc{} && ptr != text.data() && ptr == end;
+}
+
+} // namespace raw_line
+
+class IdPrefixPredicate
+{
+    std::string m_prefix;
+    std::size_t m_length;
+
+  public:
+    explicit IdPrefixPredicate(std::string prefix) : m_prefix(std::move(prefix)), m_length(m_prefix.size())
+    {
+        // padded for the masked compare in raw_line::equal_prefix
+        m_prefix.resize((m_length + raw_line::simd_width - 1) / raw_line::simd_width * raw_line::simd_width);
+    }
+    bool operator()(std::string_view line) const noexcept
+    {
+        const auto id = raw_line::field(line, raw_line::id);
+        const auto readable = static_cast<std::size_t>(line.data() + line.size() - id.data());
+        return id.size() >= m_length && raw_line::equal_prefix(id.data(), readable, m_prefix.data(), m_length);
+    }
+};
+
+template<class ValueType>
+class FieldRangePredicate
+{
+    std::size_t m_field;
+    ValueType m_min;
+    ValueType m_max;
+
+  public:
+    // accepts lines whose field lies in the closed range [min, max]
+    FieldRangePredicate(std::size_t field, ValueType min, ValueType max)
+        : m_field(field), m_min(min), m_max(max) {}
+    bool operator()(std::string_view line) const noexcept
+    {
+        ValueType value{};
+        if(!raw_line::parse(raw_line::field(line, m_field), value))
+            return false;
+        return m_min <= value && value <= m_max;
+    }
+};
+
+inline FieldRangePredicate<int> quantityRange(int min, int max)
+{
+    return {raw_line::quantity, min, max};
+}
+
+inline FieldRangePredicate<double> priceRange(double min, double max)
+{
+    return {raw_line::price, min, max};
+}
+
+// conjunction of all registered predicates; an empty filter accepts every line
+class LineFilter
+{
+    std::vector<LinePredicate> m_predicates;
+
+  public:
+    void add(LinePredicate predicate) { m_predicates.push_back(std::move(predicate)); }
+    void clear() noexcept { m_predicates.clear(); }
+    bool empty() const noexcept { return m_predicates.empty(); }
+    bool operator()(const char* linePtr, std::streamsize length) const
+    {
+        if(length < 0)
+            return false;
+        const std::string_view line{linePtr, static_cast<std::size_t>(length)};
+        for(const auto& predicate : m_predicates) {
+            if(!predicate(line))
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif // RECORD_FILTER_H
@@ -0,0 +1,219 @@
+#ifndef BROADCAST_RING_H
+#define BROADCAST_RING_H
+
+#include "adaptive_wait.h"
+#include "cache_line.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Single-writer, multi-reader broadcast ring in the Disruptor style: every
+// element is written once and read in place by every subscriber. Each
+// subscriber advances its own cursor and the writer waits on the slowest
+// one, so fan-out to an aggregator, an archiver and a validator needs
+// neither three parses nor three copies.
+//
+// Subscribers that join while the writer is running start at the element
+// published next. Elements are handed out as const references and stay in
+// the ring until overwritten, so owning pointers should be shared_ptr (or
+// deleted by a designated subscriber).
+template<std::semiregular ValueType>
+class BroadcastRing
+{
+    using SizeType = std::uint64_t;
+    static constexpr SizeType not_subscribed = std::numeric_limits<SizeType>::max();
+
+    struct alignas(std::hardware_destructive_interference_size) Cursor
+    {
+        std::atomic<SizeType> consumed{not_subscribed};
+    };
+
+  public:
+    enum op_result
+    {
+        ok = 0,
+        error_closed,
+        op_failed_buffer_empty,
+        op_failed_buffer_full
+    };
+
+    class Subscriber
+    {
+        BroadcastRing* m_ring{nullptr};
+        Cursor* m_cursor{nullptr};
+
+        friend class BroadcastRing;
+        Subscriber(BroadcastRing* ring, Cursor* cursor) : m_ring(ring), m_cursor(cursor) {}
+
+      public:
+        Subscriber() = default;
+        Subscriber(Subscriber&& other) noexcept
+            : m_ring(std::exchange(other.m_ring, nullptr)), m_cursor(std::exchange(other.m_cursor, nullptr)) {}
+        Subscriber& operator=(Subscriber&& other) noexcept
+        {
+            std::swap(m_ring, other.m_ring);
+            std::swap(m_cursor, other.m_cursor);
+            return *this;
+        }
+        Subscriber(const Subscriber&) = delete;
+        Subscriber& operator=(const Subscriber&) = delete;
+        // stops gating the writer
+        ~Subscriber()
+        {
+            if(m_cursor)
+                m_cursor->consumed.store(not_subscribed, std::memory_order_release);
+        }
+
+        // Calls f(const ValueType&) for every element published and not yet
+        // seen, at most max_batch of them, without copying; `visited` tells
+        // how many.
+        template<class Function>
+        op_result try_consume(Function&& f, std::size_t& visited,
+                              std::size_t max_batch = std::numeric_limits<std::size_t>::max())
+        {
+            visited = 0;
+            const auto position = m_cursor->consumed.load(std::memory_order_relaxed);
+            const auto available = m_ring->published.load(std::memory_order_acquire);
+            if(position == available)
+                return m_ring->closed.load(std::memory_order_acquire) &&
+                               available == m_ring->published.load(std::memory_order_acquire)
+                           ? error_closed
+                           : op_failed_buffer_empty;
+            const auto end = position + std::min<SizeType>(available - position, max_batch);
+            for(auto sequence = position; sequence < end; ++sequence)
+                f(std::as_const(m_ring->buffer[m_ring->slot(sequence)]));
+            visited = static_cast<std::size_t>(end - position);
+            m_cursor->consumed.store(end, std::memory_order_release);
+            return ok;
+        }
+
+        // blocks until at least one element was visited; returns 0 once the
+        // ring is closed and drained
+        template<class Function>
+        std::size_t consume(Function&& f, std::size_t max_batch = std::numeric_limits<std::size_t>::max())
+        {
+            adaptive_wait await{};
+            std::size_t visited = 0;
+            for(;;) {
+                const auto status = try_consume(f, visited, max_batch);
+                if(status == ok)
+                    return visited;
+                if(status == error_closed)
+                    return 0;
+                await.wait();
+            }
+        }
+
+        // elements published but not yet consumed by this subscriber
+        SizeType lag() const noexcept
+        {
+            return m_ring->published.load(std::memory_order_acquire) -
+                   m_cursor->consumed.load(std::memory_order_relaxed);
+        }
+    };
+
+    // capacity is rounded up to a power of two
+    explicit BroadcastRing(SizeType capacity, std::size_t max_subscribers = 8)
+        : buffer(std::bit_ceil(std::max<SizeType>(capacity, 1))),
+          mask(buffer.size() - 1),
+          cursors(std::make_unique<Cursor[]>(max_subscribers)),
+          cursor_count(max_subscribers)
+    {
+    }
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing(BroadcastRing&&) = delete;
+    auto operator=(const BroadcastRing&) = delete;
+    auto operator=(BroadcastRing&&) = delete;
+    ~BroadcastRing() = default;
+
+    SizeType capacity() const noexcept { return buffer.size(); }
+
+    // thread safe; throws once max_subscribers are attached
+    Subscriber subscribe()
+    {
+        for(std::size_t i = 0; i < cursor_count; ++i) {
+            auto expected = not_subscribed;
+            if(!cursors[i].consumed.compare_exchange_strong(expected, published.load(std::memory_order_acquire),
+                                                            std::memory_order_seq_cst))
+                continue;
+            // pairs with the fence in slowest_cursor(): a writer scan that
+            // missed the claim ran at a position no later than the one read
+            // now, so its gating bound cannot lap the subscriber from here on
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cursors[i].consumed.store(published.load(std::memory_order_acquire), std::memory_order_release);
+            return Subscriber{this, &cursors[i]};
+        }
+        throw std::runtime_error("too many broadcast subscribers");
+    }
+
+    void close() { closed.store(true, std::memory_order_release); }
+
+    template<typename PushedValueType>
+        requires std::convertible_to<PushedValueType, ValueType>
+    op_result try_push(PushedValueType&& value)
+    {
+        if(closed.load(std::memory_order_relaxed))
+            return error_closed;
+        const auto position = published.load(std::memory_order_relaxed);
+        if(position >= gating_bound) {
+            gating_bound = slowest_cursor(position) + capacity();
+            if(position >= gating_bound)
+                return op_failed_buffer_full;
+        }
+        buffer[slot(position)] = std::forward<PushedValueType>(value);
+        published.store(position + 1, std::memory_order_release);
+        return ok;
+    }
+
+    // single writer only; waits for the slowest subscriber
+    template<typename PushedValueType>
+        requires std::convertible_to<PushedValueType, ValueType>
+    void push(PushedValueType&& value)
+    {
+        adaptive_wait await{};
+        for(;;) {
+            auto push_result = try_push(std::forward<PushedValueType>(value));
+            if(push_result == error_closed)
+                throw std::runtime_error("invalid buffer state");
+            if(push_result == ok)
+                return;
+            await.wait();
+        }
+    }
+
+  private:
+    SizeType slot(SizeType sequence) const noexcept { return sequence & mask; }
+
+    SizeType slowest_cursor(SizeType position) const noexcept
+    {
+        auto slowest = position;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for(std::size_t i = 0; i < cursor_count; ++i) {
+            const auto consumed = cursors[i].consumed.load(std::memory_order_acquire);
+            if(consumed != not_subscribed)
+                slowest = std::min(slowest, consumed);
+        }
+        return slowest;
+    }
+
+    std::vector<ValueType> buffer;
+    SizeType mask;
+    std::unique_ptr<Cursor[]> cursors;
+    std::size_t cursor_count;
+    // writer private: elements below this bound may be written without
+    // rescanning the subscriber cursors
+    alignas(std::hardware_destructive_interference_size) SizeType gating_bound{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic<SizeType> published{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic_bool closed{false};
+};
+
+#endif // BROADCAST_RING_H
@@ -0,0 +1,14 @@
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+#include <cstddef>
+#include <new>
+
+#ifndef __cpp_lib_hardware_interference_size
+namespace std {
+inline constexpr std::size_t hardware_destructive_interference_size = 64;
+inline constexpr std::size_t hardware_constructive_interference_size = 64;
+} // namespace std
+#endif
+
+#endif // CACHE_LINE_H
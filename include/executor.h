@@ -1,8 +1,383 @@
-
-
 #ifndef EXECUTOR_H
 #define EXECUTOR_H
 
+#include "ring_buffer.h"
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Runs many coroutine tasks on a few worker threads. A task suspends
+// instead of blocking a worker:
+//  - co_await async_pop(executor, ring) / async_push(...) park the task on
+//    the RingBuffer's wait list while it is empty / full; the next push /
+//    pop (or close()) hands it back to a worker,
+//  - co_await executor.blocking(fn) runs fn (a file read) on one of the
+//    io threads and resumes the task on a worker afterwards.
+//
+//   task consume(executor& exec, RingBuffer<Record*>& ring)
+//   {
+//       while(auto record = co_await async_pop(exec, ring))
+//           process(*record);
+//   }
+//   exec.spawn(consume(exec, ring));
+//   exec.run();
+class executor;
+
+class task
+{
+  public:
+    struct promise_type
+    {
+        executor* owner{nullptr};
+
+        task get_return_object() { return task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept;
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+    };
+
+    task(task&& other) noexcept : m_coroutine(std::exchange(other.m_coroutine, {})) {}
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    task& operator=(task&&) = delete;
+    ~task()
+    {
+        if(m_coroutine)
+            m_coroutine.destroy();
+    }
+
+  private:
+    friend class executor;
+    explicit task(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+    std::coroutine_handle<promise_type> release() noexcept { return std::exchange(m_coroutine, {}); }
+    std::coroutine_handle<promise_type> m_coroutine{};
+};
+
+class executor
+{
+    std::mutex m_mutex;
+    std::condition_variable m_readyCondition;
+    std::condition_variable m_blockingCondition;
+    // a task woken from a RingBuffer wait list comes with a poll callback
+    // that retries the operation and parks the task again if it fails
+    struct ready_item
+    {
+        std::coroutine_handle<> coroutine;
+        bool (*poll)(void*){nullptr};
+        void* context{nullptr};
+    };
+
+    std::deque<ready_item> m_ready;
+    std::deque<std::function<void()>> m_blocking;
+    std::size_t m_pendingTasks{0};
+    std::exception_ptr m_error{};
+    std::size_t m_workerCount;
+    std::size_t m_ioCount;
+
+    friend class task;
+
+    void worker()
+    {
+        for(;;) {
+            ready_item next;
+            {
+                std::unique_lock lock{m_mutex};
+                m_readyCondition.wait(lock, [this] { return !m_ready.empty() || m_pendingTasks == 0; });
+                if(m_ready.empty())
+                    return;
+                next = m_ready.front();
+                m_ready.pop_front();
+            }
+            if(next.poll && !next.poll(next.context))
+                continue; // parked again
+            next.coroutine.resume();
+        }
+    }
+
+    void io_worker()
+    {
+        for(;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock{m_mutex};
+                m_blockingCondition.wait(lock, [this] { return !m_blocking.empty() || m_pendingTasks == 0; });
+                if(m_blocking.empty())
+                    return;
+                job = std::move(m_blocking.front());
+                m_blocking.pop_front();
+            }
+            job();
+        }
+    }
+
+  public:
+    explicit executor(std::size_t workerCount = 1, std::size_t ioCount = 1)
+        : m_workerCount(workerCount ? workerCount : 1), m_ioCount(ioCount ? ioCount : 1) {}
+    executor(const executor&) = delete;
+    executor& operator=(const executor&) = delete;
+
+    void spawn(task&& newTask)
+    {
+        auto coroutine = newTask.release();
+        coroutine.promise().owner = this;
+        std::lock_guard lock{m_mutex};
+        ++m_pendingTasks;
+        m_ready.push_back({coroutine});
+        m_readyCondition.notify_one();
+    }
+
+    void post(std::coroutine_handle<> coroutine, bool (*poll)(void*) = nullptr, void* context = nullptr)
+    {
+        std::lock_guard lock{m_mutex};
+        m_ready.push_back({coroutine, poll, context});
+        m_readyCondition.notify_one();
+    }
+
+    // drives every spawned task to completion; rethrows the first exception
+    // that escaped a task
+    void run()
+    {
+        std::vector<std::thread> threads;
+        for(std::size_t i = 0; i < m_ioCount; ++i)
+            threads.emplace_back(&executor::io_worker, this);
+        for(std::size_t i = 1; i < m_workerCount; ++i)
+            threads.emplace_back(&executor::worker, this);
+        worker();
+        for(auto& thread : threads)
+            thread.join();
+        std::lock_guard lock{m_mutex};
+        if(m_error)
+            std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+
+    // yields the worker to the other ready tasks
+    auto schedule()
+    {
+        struct awaiter
+        {
+            executor& exec;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> coroutine) { exec.post(coroutine); }
+            void await_resume() const noexcept {}
+        };
+        return awaiter{*this};
+    }
+
+    // runs a blocking call on an io thread while the task is suspended
+    template<class Function>
+    auto blocking(Function function)
+    {
+        using ResultType = std::invoke_result_t<Function&>;
+        using StoredType = std::conditional_t<std::is_void_v<ResultType>, std::monostate, ResultType>;
+        struct awaiter
+        {
+            executor& exec;
+            Function function;
+            std::optional<StoredType> result{};
+            std::exception_ptr error{};
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> coroutine)
+            {
+                std::lock_guard lock{exec.m_mutex};
+                exec.m_blocking.push_back([this, coroutine] {
+                    try {
+                        if constexpr(std::is_void_v<ResultType>) {
+                            function();
+                            result.emplace();
+                        } else {
+                            result.emplace(function());
+                        }
+                    } catch(...) {
+                        error = std::current_exception();
+                    }
+                    exec.post(coroutine);
+                });
+                exec.m_blockingCondition.notify_one();
+            }
+            ResultType await_resume()
+            {
+                if(error)
+                    std::rethrow_exception(error);
+                if constexpr(!std::is_void_v<ResultType>)
+                    return std::move(*result);
+            }
+        };
+        return awaiter{*this, std::move(function)};
+    }
+
+  private:
+    void task_finished(std::exception_ptr error)
+    {
+        std::lock_guard lock{m_mutex};
+        if(error && !m_error)
+            m_error = error;
+        if(--m_pendingTasks == 0) {
+            m_readyCondition.notify_all();
+            m_blockingCondition.notify_all();
+        }
+    }
+};
+
+inline auto task::promise_type::final_suspend() noexcept
+{
+    struct awaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+        {
+            auto* owner = coroutine.promise().owner;
+            coroutine.destroy();
+            if(owner)
+                owner->task_finished(nullptr);
+        }
+        void await_resume() const noexcept {}
+    };
+    return awaiter{};
+}
+
+inline void task::promise_type::unhandled_exception() noexcept
+{
+    if(owner)
+        owner->task_finished(std::current_exception());
+    owner = nullptr; // final_suspend must not count the task twice
+}
+
+// Parks a task on a RingBuffer wait list. Derived provides attempt(), which
+// performs the operation and tells whether the task can resume, and
+// wait_list()/readiness() for the direction it waits in; readiness()
+// returns a check that must not refer to the awaiter.
+template<class Derived>
+struct ring_awaiter : ring_waiter
+{
+    executor& exec;
+    std::coroutine_handle<> coroutine{};
+
+    explicit ring_awaiter(executor& owner) : ring_waiter{&ring_awaiter::woken}, exec(owner) {}
+
+    bool await_ready() { return self().attempt(); }
+    void await_suspend(std::coroutine_handle<> suspended)
+    {
+        coroutine = suspended;
+        park();
+    }
+
+  private:
+    Derived& self() noexcept { return static_cast<Derived&>(*this); }
+
+    static void woken(ring_waiter* waiter)
+    {
+        auto& awaiter = static_cast<ring_awaiter&>(*waiter);
+        awaiter.exec.post(awaiter.coroutine, &ring_awaiter::poll, &awaiter);
+    }
+
+    // runs on a worker; another task may have been faster
+    static bool poll(void* context)
+    {
+        auto& awaiter = *static_cast<ring_awaiter*>(context);
+        if(awaiter.self().attempt())
+            return true;
+        awaiter.park();
+        return false;
+    }
+
+    void park()
+    {
+        // once added, a notify may resume the task (and free this awaiter)
+        // on another worker, so only locals are used from here on
+        auto& list = self().wait_list();
+        auto ready = self().readiness();
+        auto& owner = exec;
+        const auto suspended = coroutine;
+        // add() counts the waiter with a seq_cst RMW and the ring updates
+        // its positions seq_cst before checking that count, so either the
+        // re-check sees the element or the notify sees the waiter
+        list.add(*this);
+        if(!ready())
+            return;
+        if(list.remove(*this))
+            owner.post(suspended, &ring_awaiter::poll, this);
+    }
+};
+
+// pops without blocking the worker; std::nullopt once the ring is closed
+// and drained
+template<class ValueType, class Allocator>
+auto async_pop(executor& exec, RingBuffer<ValueType, Allocator>& ring)
+{
+    using Ring = RingBuffer<ValueType, Allocator>;
+    struct awaiter : ring_awaiter<awaiter>
+    {
+        Ring& ring;
+        ValueType value{};
+        bool closed{false};
+
+        awaiter(executor& owner, Ring& target) : ring_awaiter<awaiter>(owner), ring(target) {}
+        bool attempt()
+        {
+            const auto status = ring.try_pop(value);
+            closed = status == Ring::error_closed;
+            return closed || status == Ring::ok;
+        }
+        ring_wait_list& wait_list() noexcept { return ring.pop_wait_list(); }
+        auto readiness() const
+        {
+            return [&ring = ring] { return ring.pop_ready(); };
+        }
+
+        std::optional<ValueType> await_resume()
+        {
+            if(closed)
+                return std::nullopt;
+            return std::move(value);
+        }
+    };
+    return awaiter{exec, ring};
+}
+
+// pushes without blocking the worker; false if the ring was closed
+template<class ValueType, class Allocator, class PushedValueType>
+    requires std::convertible_to<PushedValueType, ValueType>
+auto async_push(executor& exec, RingBuffer<ValueType, Allocator>& ring, PushedValueType&& pushed)
+{
+    using Ring = RingBuffer<ValueType, Allocator>;
+    struct awaiter : ring_awaiter<awaiter>
+    {
+        Ring& ring;
+        ValueType value;
+        bool closed{false};
+
+        awaiter(executor& owner, Ring& target, ValueType&& pushedValue)
+            : ring_awaiter<awaiter>(owner), ring(target), value(std::move(pushedValue)) {}
+        bool attempt()
+        {
+            const auto status = ring.try_push(std::move(value));
+            closed = status == Ring::error_closed;
+            return closed || status == Ring::ok;
+        }
+        ring_wait_list& wait_list() noexcept { return ring.push_wait_list(); }
+        auto readiness() const
+        {
+            return [&ring = ring] { return ring.push_ready(); };
+        }
 
+        bool await_resume() const noexcept { return !closed; }
+    };
+    return awaiter{exec, ring, ValueType(std::forward<PushedValueType>(pushed))};
+}
 
-#endif
+#endif // EXECUTOR_H
@@ -0,0 +1,126 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Minimal lazy generator (std::generator is C++23); models
+// std::ranges::input_range, so readers compose with range adaptors:
+//
+//   for(auto* record : records(parser) | std::views::filter(&Record::Valid))
+template<class ValueType>
+class generator : public std::ranges::view_interface<generator<ValueType>>
+{
+    using value_pointer = std::add_pointer_t<std::remove_reference_t<ValueType>>;
+
+  public:
+    struct promise_type
+    {
+        value_pointer value{nullptr};
+        std::exception_ptr error{};
+
+        generator get_return_object()
+        {
+            return generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        // the yielded object lives in the coroutine frame until the next resume
+        std::suspend_always yield_value(std::remove_reference_t<ValueType>& yielded) noexcept
+        {
+            value = std::addressof(yielded);
+            return {};
+        }
+        std::suspend_always yield_value(std::remove_reference_t<ValueType>&& yielded) noexcept
+        {
+            value = std::addressof(yielded);
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { error = std::current_exception(); }
+        template<class Unused>
+        std::suspend_never await_transform(Unused&&) = delete;
+    };
+
+    class iterator
+    {
+        std::coroutine_handle<promise_type> m_coroutine{};
+
+      public:
+        using value_type = std::remove_cvref_t<ValueType>;
+        using reference = std::remove_reference_t<ValueType>&;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+
+        reference operator*() const { return *m_coroutine.promise().value; }
+        iterator& operator++()
+        {
+            m_coroutine.resume();
+            if(m_coroutine.done() && m_coroutine.promise().error)
+                std::rethrow_exception(m_coroutine.promise().error);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return !m_coroutine || m_coroutine.done(); }
+    };
+
+    generator() = default;
+    generator(const generator&) = delete;
+    generator(generator&& other) noexcept : m_coroutine(std::exchange(other.m_coroutine, {})) {}
+    generator& operator=(const generator&) = delete;
+    generator& operator=(generator&& other) noexcept
+    {
+        std::swap(m_coroutine, other.m_coroutine);
+        return *this;
+    }
+    ~generator()
+    {
+        if(m_coroutine)
+            m_coroutine.destroy();
+    }
+
+    // single pass: begin() starts the coroutine and may be called once
+    iterator begin()
+    {
+        if(m_coroutine) {
+            m_coroutine.resume();
+            if(m_coroutine.done() && m_coroutine.promise().error)
+                std::rethrow_exception(m_coroutine.promise().error);
+        }
+        return iterator{m_coroutine};
+    }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+  private:
+    explicit generator(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+    std::coroutine_handle<promise_type> m_coroutine{};
+};
+
+// every record of an IFileReader, including the trailing end-of-file record
+template<class Reader>
+generator<decltype(std::declval<Reader&>().getRecord())> records(Reader& reader)
+{
+    while(reader.good())
+        co_yield reader.getRecord();
+}
+
+// raw lines of a FileParser without building records; each view is valid
+// until the generator is advanced
+template<class Parser>
+generator<std::string_view> lines(Parser& parser)
+{
+    std::string_view line;
+    while(parser.getLine(line))
+        co_yield line;
+}
+
+#endif // GENERATOR_H
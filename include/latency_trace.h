@@ -0,0 +1,255 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include "ChunkExtractor.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <iomanip>
+#include <ios>
+#include <ostream>
+#include <thread>
+#include <utility>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Optional per-record latency tracing. Records (or batches) wrapped in
+// traced<> are stamped when extracted by the parser, when pushed into a
+// RingBuffer and when popped by the consumer; RingBuffer calls the
+// on_enqueue()/on_dequeue() hooks only for such types, so untraced queues
+// pay nothing. On dequeue the three stage latencies are added, in TSC
+// ticks, to the histograms of latency_tracer::instance(), which can be read
+// or printed while the pipeline runs:
+//
+//   TracedRecordParser parser(fname, "feed", csv);   // yields traced<Record*>
+//   RingBuffer<traced<Record*>> ring(4096);
+//   ...
+//   latency_tracer::instance().report(std::cerr);
+
+// invariant TSC ticks, converted to nanoseconds with a ratio calibrated
+// against steady_clock (a 10 ms sleep) on the first conversion; tracing
+// itself only reads the counter, so calibrate() up front or let the first
+// report pay for it
+struct tsc_clock
+{
+    static std::uint64_t now() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    static double nanoseconds_per_tick()
+    {
+        static const double ratio = [] {
+#if defined(__x86_64__) || defined(__i386__)
+            const auto wall_start = std::chrono::steady_clock::now();
+            const auto tsc_start = now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            const auto tsc_end = now();
+            const auto wall_end = std::chrono::steady_clock::now();
+            const auto elapsed = std::chrono::duration<double, std::nano>(wall_end - wall_start).count();
+            return tsc_end > tsc_start ? elapsed / static_cast<double>(tsc_end - tsc_start) : 1.0;
+#else
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+        }();
+        return ratio;
+    }
+
+    static void calibrate() { nanoseconds_per_tick(); }
+
+    static std::uint64_t to_nanoseconds(std::uint64_t ticks)
+    {
+        return static_cast<std::uint64_t>(static_cast<double>(ticks) * nanoseconds_per_tick());
+    }
+};
+
+// HDR-style log-linear histogram of integer values (TSC ticks for
+// latency_tracer): exact below 64, then 32 sub-buckets per power of two
+// (about 3% relative error). Recording is a single relaxed fetch_add, safe
+// from any number of threads.
+class latency_histogram
+{
+    static constexpr unsigned precision_bits = 6;
+    static constexpr std::uint64_t linear_range = 1ull << precision_bits;
+    static constexpr std::uint64_t sub_buckets = linear_range / 2;
+    static constexpr std::size_t bucket_count = linear_range + (64 - precision_bits) * sub_buckets;
+
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets{};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> maximum{0};
+
+  public:
+    static constexpr std::size_t bucket_index(std::uint64_t value) noexcept
+    {
+        if(value < linear_range)
+            return static_cast<std::size_t>(value);
+        const auto shift = static_cast<unsigned>(std::bit_width(value)) - precision_bits;
+        const auto mantissa = value >> shift;
+        return static_cast<std::size_t>(linear_range + (shift - 1) * sub_buckets + (mantissa - sub_buckets));
+    }
+
+    static constexpr std::uint64_t bucket_lower_bound(std::size_t index) noexcept
+    {
+        if(index < linear_range)
+            return index;
+        const auto offset = index - linear_range;
+        const auto shift = offset / sub_buckets + 1;
+        return (offset % sub_buckets + sub_buckets) << shift;
+    }
+
+    void record(std::uint64_t value) noexcept
+    {
+        buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        auto current = maximum.load(std::memory_order_relaxed);
+        while(value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::uint64_t count() const noexcept { return total.load(std::memory_order_relaxed); }
+    std::uint64_t max() const noexcept { return maximum.load(std::memory_order_relaxed); }
+
+    // highest value equivalent to the percentile's bucket
+    std::uint64_t percentile(double percent) const noexcept
+    {
+        const auto recorded = count();
+        if(recorded == 0)
+            return 0;
+        const auto wanted = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(static_cast<double>(recorded) * std::clamp(percent, 0.0, 100.0) / 100.0 + 0.5));
+        std::uint64_t seen = 0;
+        for(std::size_t index = 0; index < bucket_count; ++index) {
+            seen += buckets[index].load(std::memory_order_relaxed);
+            if(seen >= wanted)
+                return std::min(max(), index + 1 < bucket_count ? bucket_lower_bound(index + 1) - 1 : max());
+        }
+        return max();
+    }
+
+    void reset() noexcept
+    {
+        for(auto& bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+};
+
+class latency_tracer
+{
+  public:
+    enum stage : std::size_t
+    {
+        extract_to_enqueue = 0, // parsing plus waiting for queue space
+        enqueue_to_dequeue,     // time spent in the queue
+        extract_to_dequeue,     // end to end
+        stage_count
+    };
+
+    static latency_tracer& instance()
+    {
+        static latency_tracer tracer;
+        return tracer;
+    }
+
+    void enable(bool on) noexcept { enabled.store(on, std::memory_order_relaxed); }
+    bool is_enabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+    // TSC stamps; a zero stamp means the point was not traced
+    void record(std::uint64_t extracted, std::uint64_t enqueued, std::uint64_t dequeued) noexcept
+    {
+        if(!is_enabled())
+            return;
+        auto add = [&](stage which, std::uint64_t from, std::uint64_t to) {
+            if(from && to >= from)
+                histograms[which].record(to - from);
+        };
+        add(extract_to_enqueue, extracted, enqueued);
+        add(enqueue_to_dequeue, enqueued, dequeued);
+        add(extract_to_dequeue, extracted, dequeued);
+    }
+
+    // in TSC ticks; percentile_ns()/max_ns() convert
+    const latency_histogram& histogram(stage which) const noexcept { return histograms[which]; }
+    std::uint64_t percentile_ns(stage which, double percent) const
+    {
+        return tsc_clock::to_nanoseconds(histograms[which].percentile(percent));
+    }
+    std::uint64_t max_ns(stage which) const { return tsc_clock::to_nanoseconds(histograms[which].max()); }
+
+    void reset() noexcept
+    {
+        for(auto& histogram : histograms)
+            histogram.reset();
+    }
+
+    void report(std::ostream& os) const
+    {
+        static constexpr std::array names = {"extract->enqueue", "enqueue->dequeue", "extract->dequeue"};
+        const auto flags = os.flags();
+        const auto precision = os.precision();
+        os << std::fixed << std::setprecision(1);
+        for(std::size_t index = 0; index < stage_count; ++index) {
+            const auto which = static_cast<stage>(index);
+            auto us = [&](double percent) { return static_cast<double>(percentile_ns(which, percent)) / 1000.0; };
+            os << std::left << std::setw(18) << names[index] << " count " << histograms[index].count() << " p50 "
+               << us(50) << "us p90 " << us(90) << "us p99 " << us(99) << "us p99.9 " << us(99.9) << "us max "
+               << static_cast<double>(max_ns(which)) / 1000.0 << "us\n";
+        }
+        os.flags(flags);
+        os.precision(precision);
+    }
+
+  private:
+    latency_tracer() = default;
+    std::atomic_bool enabled{true};
+    std::array<latency_histogram, stage_count> histograms{};
+};
+
+template<std::semiregular ValueType>
+struct traced
+{
+    ValueType value{};
+    std::uint64_t extracted{0};
+    std::uint64_t enqueued{0};
+
+    // RingBuffer hooks
+    void on_enqueue() noexcept { enqueued = tsc_clock::now(); }
+    void on_dequeue() const noexcept { latency_tracer::instance().record(extracted, enqueued, tsc_clock::now()); }
+};
+
+// wraps a parser extractor, stamping each record as it is extracted
+template<class Extractor>
+class TracedExtractFunctor
+{
+    Extractor m_Extractor;
+
+  public:
+    using ExtractedType = traced<typename Extractor::ExtractedType>;
+    template<class... Args>
+    explicit TracedExtractFunctor(Args&&... args) : m_Extractor(std::forward<Args>(args)...) {}
+    ExtractedType operator()(const char* RecPtr, std::streamsize length)
+    {
+        const auto extracted = tsc_clock::now();
+        return {m_Extractor(RecPtr, length), extracted, 0};
+    }
+};
+
+// yields traced<Record*> stamped at extraction
+using TracedRecordParser =
+    FileParser<Record,
+               TracedExtractFunctor<RecordExtractFunctor<
+                   Record*, char, std::char_traits<char>, DEFAULT_BUFFER_SIZE>>,
+               char, std::char_traits<char>, DEFAULT_BUFFER_SIZE>;
+
+#endif // LATENCY_TRACE_H
@@ -0,0 +1,356 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "ring_buffer.h"
+#include "topology.h"
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// source -> transform stages -> sink, every edge a bounded RingBuffer.
+// A full edge blocks its producers in RingBuffer::push(), so a slow stage
+// throttles everything upstream of it. When the last worker of a stage
+// finishes it closes the stage's output edge, and the downstream workers
+// stop once that edge is drained.
+//
+//   auto pipeline = Pipeline::from("parse", reader_source(parser), 4096)
+//                       .then("enrich", enrich, 4, 4096)
+//                       .sink("store", store, 2);
+//   pipeline->run();
+//
+// Callables of stages running with parallelism > 1 are shared by all
+// workers of the stage and must be thread safe.
+//
+// place_on(NodePlacement) keeps the whole chain on one NUMA node: workers
+// are pinned to the node's cores and the edges are allocated there when
+// the pipeline starts.
+
+struct StageStats
+{
+    std::string name;
+    std::size_t parallelism{0};
+    std::uint64_t processed{0};
+    double per_second{0};
+    // the edge feeding the stage; zero for the source
+    std::size_t input_queue_size{0};
+    std::size_t input_queue_capacity{0};
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StageStats& stats)
+{
+    os << stats.name << " x" << stats.parallelism << ": " << stats.processed << " items, "
+       << static_cast<std::uint64_t>(stats.per_second) << " items/s";
+    if(stats.input_queue_capacity)
+        os << ", input queue " << stats.input_queue_size << '/' << stats.input_queue_capacity;
+    return os;
+}
+
+template<class Reader>
+auto reader_source(Reader& reader)
+{
+    using ValueType = decltype(reader.getRecord());
+    return [&reader]() -> std::optional<ValueType> {
+        if(!reader.good())
+            return std::nullopt;
+        return reader.getRecord();
+    };
+}
+
+class Pipeline
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct edge_base
+    {
+        virtual ~edge_base() = default;
+        virtual void allocate(int node) = 0;
+        virtual void close() = 0;
+        virtual std::size_t size() const = 0;
+        virtual std::size_t capacity() const = 0;
+    };
+
+    // storage is allocated by start(), once the placement is known
+    template<std::semiregular ValueType>
+    struct edge : edge_base
+    {
+        using BufferType = RingBuffer<ValueType, numa_allocator<ValueType>>;
+        std::unique_ptr<BufferType> buffer;
+        std::size_t buffer_capacity;
+        explicit edge(std::size_t capacity) : buffer_capacity(capacity) {}
+        void allocate(int node) override
+        {
+            buffer = std::make_unique<BufferType>(buffer_capacity, numa_allocator<ValueType>(node));
+        }
+        void close() override
+        {
+            if(buffer)
+                buffer->close();
+        }
+        std::size_t size() const override { return buffer ? buffer->size() : 0; }
+        std::size_t capacity() const override { return buffer_capacity; }
+    };
+
+    struct stage
+    {
+        std::string name;
+        std::size_t parallelism;
+        std::function<void(stage&)> body;
+        edge_base* input{nullptr};
+        edge_base* output{nullptr};
+        std::atomic<std::uint64_t> processed{0};
+        std::atomic<std::size_t> running{0};
+        std::atomic<Clock::rep> finished{0};
+    };
+
+    std::vector<std::unique_ptr<edge_base>> edges;
+    std::vector<std::unique_ptr<stage>> stages;
+    std::vector<std::thread> workers;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    std::atomic_bool aborted{false};
+    std::optional<NodePlacement> placement;
+    Clock::time_point started{};
+
+    Pipeline() = default;
+
+    template<std::semiregular ValueType>
+    edge<ValueType>* add_edge(std::size_t capacity)
+    {
+        auto new_edge = std::make_unique<edge<ValueType>>(capacity);
+        auto* result = new_edge.get();
+        edges.push_back(std::move(new_edge));
+        return result;
+    }
+
+    stage& add_stage(std::string name, std::size_t parallelism, std::function<void(stage&)> body)
+    {
+        if(parallelism == 0)
+            throw std::invalid_argument("stage parallelism must be positive");
+        auto new_stage = std::make_unique<stage>();
+        new_stage->name = std::move(name);
+        new_stage->parallelism = parallelism;
+        new_stage->body = std::move(body);
+        if(!stages.empty())
+            new_stage->input = stages.back()->output;
+        stages.push_back(std::move(new_stage));
+        return *stages.back();
+    }
+
+    void run_worker(stage& current)
+    {
+        try {
+            current.body(current);
+        } catch(...) {
+            if(!aborted.load()) {
+                std::lock_guard lock{error_mutex};
+                if(!error)
+                    error = std::current_exception();
+            }
+            abort();
+        }
+        if(current.running.fetch_sub(1) == 1) {
+            current.finished = Clock::now().time_since_epoch().count();
+            if(current.output)
+                current.output->close();
+        }
+    }
+
+  public:
+    template<std::semiregular ValueType>
+    class builder;
+
+    // source() returns std::nullopt once exhausted
+    template<class Source>
+    static auto from(std::string name, Source source, std::size_t capacity,
+                     std::size_t parallelism = 1)
+    {
+        using ValueType = typename std::invoke_result_t<Source&>::value_type;
+        std::unique_ptr<Pipeline> pipeline{new Pipeline()};
+        auto* output = pipeline->add_edge<ValueType>(capacity);
+        auto shared_source = std::make_shared<Source>(std::move(source));
+        auto& source_stage = pipeline->add_stage(std::move(name), parallelism, [output, shared_source](stage& self) {
+            auto& output_buffer = *output->buffer;
+            for(;;) {
+                auto item = (*shared_source)();
+                if(!item)
+                    return;
+                output_buffer.push(std::move(*item));
+                self.processed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        source_stage.output = output;
+        return builder<ValueType>(std::move(pipeline), output);
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline(Pipeline&&) = delete;
+    auto operator=(const Pipeline&) = delete;
+    auto operator=(Pipeline&&) = delete;
+    ~Pipeline()
+    {
+        if(!workers.empty()) {
+            abort();
+            for(auto& worker : workers)
+                if(worker.joinable())
+                    worker.join();
+        }
+    }
+
+    void start()
+    {
+        if(!workers.empty())
+            throw std::logic_error("pipeline already started");
+        for(auto& current : edges)
+            current->allocate(placement ? static_cast<int>(placement->node()) : -1);
+        started = Clock::now();
+        for(auto& current : stages) {
+            current->running = current->parallelism;
+            for(std::size_t i = 0; i < current->parallelism; ++i) {
+                if(placement)
+                    workers.push_back(placement->spawn(&Pipeline::run_worker, this, std::ref(*current)));
+                else
+                    workers.emplace_back(&Pipeline::run_worker, this, std::ref(*current));
+            }
+        }
+    }
+
+    // joins all workers; rethrows the first exception raised by a stage
+    void wait()
+    {
+        for(auto& worker : workers)
+            if(worker.joinable())
+                worker.join();
+        std::lock_guard lock{error_mutex};
+        if(error)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+    // must be called before start()
+    void place_on(NodePlacement node_placement) { placement = std::move(node_placement); }
+
+    void run()
+    {
+        start();
+        wait();
+    }
+
+    // closes every edge; workers stop at their next item without processing
+    // it, and the items still queued are discarded with the pipeline.
+    void abort()
+    {
+        aborted = true;
+        for(auto& current : edges)
+            current->close();
+    }
+
+    std::vector<StageStats> stats() const
+    {
+        std::vector<StageStats> result;
+        result.reserve(stages.size());
+        const auto now = Clock::now();
+        for(const auto& current : stages) {
+            StageStats stats{current->name, current->parallelism, current->processed.load()};
+            const auto finished = current->finished.load();
+            const auto end = finished ? Clock::time_point(Clock::duration(finished)) : now;
+            const auto elapsed = std::chrono::duration<double>(end - started).count();
+            if(started != Clock::time_point{} && elapsed > 0)
+                stats.per_second = static_cast<double>(stats.processed) / elapsed;
+            if(current->input) {
+                stats.input_queue_size = current->input->size();
+                stats.input_queue_capacity = current->input->capacity();
+            }
+            result.push_back(std::move(stats));
+        }
+        return result;
+    }
+
+    void report(std::ostream& os) const
+    {
+        for(const auto& stats : this->stats())
+            os << stats << '\n';
+    }
+};
+
+template<std::semiregular ValueType>
+class Pipeline::builder
+{
+    friend class Pipeline;
+    template<std::semiregular>
+    friend class builder;
+
+    std::unique_ptr<Pipeline> pipeline;
+    edge<ValueType>* tail;
+
+    builder(std::unique_ptr<Pipeline> owned, edge<ValueType>* last_edge)
+        : pipeline(std::move(owned)), tail(last_edge) {}
+
+  public:
+    template<class Transform>
+        requires std::invocable<Transform&, ValueType>
+    auto then(std::string name, Transform transform, std::size_t parallelism, std::size_t capacity) &&
+    {
+        using ResultType = std::invoke_result_t<Transform&, ValueType>;
+        auto* input = tail;
+        auto* output = pipeline->template add_edge<ResultType>(capacity);
+        auto shared_transform = std::make_shared<Transform>(std::move(transform));
+        auto& transform_stage = pipeline->add_stage(
+            std::move(name), parallelism, [owner = pipeline.get(), input, output, shared_transform](stage& self) {
+                auto& input_buffer = *input->buffer;
+                auto& output_buffer = *output->buffer;
+                for(;;) {
+                    ValueType item;
+                    try {
+                        item = input_buffer.pop();
+                    } catch(const std::runtime_error&) {
+                        return; // input closed and drained
+                    }
+                    if(owner->aborted.load(std::memory_order_relaxed))
+                        return;
+                    output_buffer.push((*shared_transform)(std::move(item)));
+                    self.processed.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        transform_stage.output = output;
+        return builder<ResultType>(std::move(pipeline), output);
+    }
+
+    template<class Sink>
+        requires std::invocable<Sink&, ValueType>
+    std::unique_ptr<Pipeline> sink(std::string name, Sink consume, std::size_t parallelism = 1) &&
+    {
+        auto* input = tail;
+        auto shared_sink = std::make_shared<Sink>(std::move(consume));
+        pipeline->add_stage(std::move(name), parallelism, [owner = pipeline.get(), input, shared_sink](stage& self) {
+            auto& input_buffer = *input->buffer;
+            for(;;) {
+                ValueType item;
+                try {
+                    item = input_buffer.pop();
+                } catch(const std::runtime_error&) {
+                    return;
+                }
+                if(owner->aborted.load(std::memory_order_relaxed))
+                    return;
+                (*shared_sink)(std::move(item));
+                self.processed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        return std::move(pipeline);
+    }
+};
+
+#endif // PIPELINE_H
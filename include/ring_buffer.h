@@ -2,11 +2,13 @@
 #define RING_BUFFER_H
 
 #include "adaptive_wait.h"
+#include "cache_line.h"
 
 #include <atomic>
 #include <bit>
 #include <cmath>
 #include <concepts>
+#include <memory>
 #include <mutex>
 #include <new>
 #include <shared_mutex>
@@ -15,25 +17,102 @@
 #include <vector>
 
 constexpr inline std::size_t default_storage_size = 32768;
-#ifndef __cpp_lib_hardware_interference_size
-namespace std {
-inline constexpr std::size_t hardware_destructive_interference_size = 64;
-inline constexpr std::size_t hardware_constructive_interference_size = 64;
-} // namespace std
-#endif
 
-template<std::semiregular ValueType>
+// A suspended consumer or producer of a RingBuffer (see executor.h). wake()
+// is called once, after the waiter was unlinked; the waiter may be gone as
+// soon as it returns.
+struct ring_waiter
+{
+    void (*wake)(ring_waiter*){nullptr};
+    ring_waiter* next{nullptr};
+};
+
+// FIFO of parked waiters. Notifying an empty list costs one atomic load, so
+// rings without suspended waiters pay next to nothing.
+class ring_wait_list
+{
+    std::mutex mutex{};
+    ring_waiter* head{nullptr};
+    ring_waiter* tail{nullptr};
+    std::atomic<std::size_t> count{0};
+
+    ring_waiter* take_locked() noexcept
+    {
+        auto* waiter = head;
+        if(waiter) {
+            head = waiter->next;
+            if(!head)
+                tail = nullptr;
+            count.fetch_sub(1);
+        }
+        return waiter;
+    }
+
+  public:
+    // the caller must re-check the ring afterwards: a notify that ran before
+    // add() is not replayed
+    void add(ring_waiter& waiter)
+    {
+        std::lock_guard lock{mutex};
+        waiter.next = nullptr;
+        (tail ? tail->next : head) = &waiter;
+        tail = &waiter;
+        count.fetch_add(1);
+    }
+
+    // false if a notify already took the waiter
+    bool remove(ring_waiter& waiter)
+    {
+        std::lock_guard lock{mutex};
+        ring_waiter* previous = nullptr;
+        for(auto* current = head; current; previous = current, current = current->next) {
+            if(current != &waiter)
+                continue;
+            (previous ? previous->next : head) = current->next;
+            if(tail == current)
+                tail = previous;
+            count.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void notify_one()
+    {
+        if(count.load() == 0)
+            return;
+        ring_waiter* waiter = nullptr;
+        {
+            std::lock_guard lock{mutex};
+            waiter = take_locked();
+        }
+        if(waiter)
+            waiter->wake(waiter);
+    }
+
+    void notify_all()
+    {
+        if(count.load() == 0)
+            return;
+        ring_waiter* waiters = nullptr;
+        {
+            std::lock_guard lock{mutex};
+            waiters = std::exchange(head, nullptr);
+            tail = nullptr;
+            count.store(0);
+        }
+        while(waiters) {
+            auto* waiter = std::exchange(waiters, waiters->next);
+            waiter->wake(waiter);
+        }
+    }
+};
+
+template<std::semiregular ValueType, class Allocator = std::allocator<ValueType>>
 class RingBuffer
 {
-    using BufferType = std::vector<ValueType>;
+    using BufferType = std::vector<ValueType, Allocator>;
     using SizeType = typename BufferType::size_type;
-    enum op_result
-    {
-        ok = 0,
-        error_closed,
-        op_failed_buffer_empty,
-        op_failed_buffer_full
-    };
     static constexpr std::size_t circular_index_mask = default_storage_size - 1;
 
     BufferType buffer;
@@ -45,9 +124,20 @@ class RingBuffer
     alignas(std::hardware_destructive_interference_size) std::atomic<SizeType> ring_buffer_capacity{0};
     alignas(std::hardware_destructive_interference_size) std::atomic_bool push_waiting{false};
     alignas(std::hardware_destructive_interference_size) bool closed{false};
+    alignas(std::hardware_destructive_interference_size) ring_wait_list pop_waiters{};
+    alignas(std::hardware_destructive_interference_size) ring_wait_list push_waiters{};
 
   public:
-    explicit RingBuffer(SizeType buffer_capacity)
+    enum op_result
+    {
+        ok = 0,
+        error_closed,
+        op_failed_buffer_empty,
+        op_failed_buffer_full
+    };
+
+    explicit RingBuffer(SizeType buffer_capacity, const Allocator& allocator = Allocator())
+        : buffer(allocator)
     {
         buffer.resize(buffer_capacity);
         ring_buffer_capacity = std::bit_ceil(buffer.size());
@@ -63,11 +153,44 @@ class RingBuffer
     {
         if(push_waiting.exchange(true))
             return;
-        std::unique_lock write_lock{mutex};
-        closed = true;
+        {
+            std::unique_lock write_lock{mutex};
+            closed = true;
+        }
         push_waiting.store(false);
+        pop_waiters.notify_all();
+        push_waiters.notify_all();
+    }
+
+    // Waiters parked here are woken by the next successful push (pop
+    // waiters) or pop (push waiters), one per element, and all of them by
+    // close(). After add(), check pop_ready()/push_ready() before sleeping.
+    ring_wait_list& pop_wait_list() noexcept { return pop_waiters; }
+    ring_wait_list& push_wait_list() noexcept { return push_waiters; }
+
+    // true if try_pop() would not report op_failed_buffer_empty
+    bool pop_ready() const
+    {
+        std::shared_lock read_lock{mutex};
+        return closed || pending_pop_position.load() != push_position.load();
     }
 
+    // true if try_push() would not report op_failed_buffer_full
+    bool push_ready() const
+    {
+        std::shared_lock read_lock{mutex};
+        return closed || !is_full(pop_position.load(), ring_next_pos(pending_push_position.load()));
+    }
+
+    // lock-free hint for callers choosing between rings, e.g. ShardedQueue;
+    // may be stale in both directions, and is true for a closed empty ring
+    bool appears_empty() const noexcept
+    {
+        return pending_pop_position.load(std::memory_order_relaxed) == push_position.load(std::memory_order_relaxed);
+    }
+
+    SizeType capacity() const noexcept { return buffer.size(); }
+
     SizeType size() const noexcept
     {
         std::unique_lock write_lock(mutex);
@@ -128,6 +251,8 @@ class RingBuffer
                                                            next_local_push_position)) {
                 auto push_it = std::ranges::begin(buffer) + ring_position(local_pending_push_position);
                 *push_it = std::forward<PushedValueType>(value);
+                if constexpr(requires { push_it->on_enqueue(); })
+                    push_it->on_enqueue(); // latency tracing, see latency_trace.h
                 {
                     adaptive_wait await{};
                     SizeType acquired_slot = local_pending_push_position;
@@ -137,6 +262,7 @@ class RingBuffer
                         await.wait();
                     }
                 }
+                pop_waiters.notify_one();
                 return ok;
             }
             await.wait();
@@ -173,11 +299,15 @@ class RingBuffer
                 await.wait();
             }
         }
+        // after the slot is released, so tracing never holds up other consumers
+        if constexpr(requires { value.on_dequeue(); })
+            value.on_dequeue();
+        push_waiters.notify_one();
         return ok;
     }
 
   private:
-    SizeType ring_next_pos(SizeType position)
+    SizeType ring_next_pos(SizeType position) const
     {
         if(ring_position(++position) >= buffer.size())
             position += ring_buffer_capacity - buffer.size(); // If the position reached
@@ -0,0 +1,231 @@
+#ifndef SEGMENTED_QUEUE_H
+#define SEGMENTED_QUEUE_H
+
+#include "adaptive_wait.h"
+#include "cache_line.h"
+#include "spin_lock.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Unbounded companion of RingBuffer for bursty producers: a linked list of
+// fixed-size segments. Producers append under the tail lock, consumers read
+// under the head lock, so the two sides only meet on the per-segment
+// `published` counter. Drained segments go back to a free list and are
+// reused before anything new is allocated. With a soft capacity,
+// try_push() reports op_failed_buffer_full once that many elements are
+// queued and no free segment is left, and push() waits like
+// RingBuffer::push() does. The push/pop/try_push/try_pop/close contract
+// matches RingBuffer.
+template<std::semiregular ValueType, std::size_t SEGMENT_SIZE = 1024>
+class SegmentedQueue
+{
+    static_assert(SEGMENT_SIZE > 0);
+
+    struct Segment
+    {
+        std::array<ValueType, SEGMENT_SIZE> slots{};
+        // written under the tail lock, read by consumers
+        std::atomic<std::size_t> published{0};
+        std::atomic<Segment*> next{nullptr};
+        // touched under the head lock only
+        std::size_t consumed{0};
+    };
+
+  public:
+    using SizeType = std::size_t;
+    enum op_result
+    {
+        ok = 0,
+        error_closed,
+        op_failed_buffer_empty,
+        op_failed_buffer_full
+    };
+
+  private:
+    std::vector<std::unique_ptr<Segment>> segments; // owns every segment, guarded by pool_lock
+    std::vector<Segment*> free_segments;
+    SizeType max_segments{0}; // 0: unbounded
+    alignas(std::hardware_destructive_interference_size) spin_lock pool_lock{};
+    alignas(std::hardware_destructive_interference_size) spin_lock head_lock{};
+    Segment* head{nullptr};
+    alignas(std::hardware_destructive_interference_size) spin_lock tail_lock{};
+    Segment* tail{nullptr};
+    alignas(std::hardware_destructive_interference_size) std::atomic<SizeType> pushed{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic<SizeType> popped{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic_bool closed{false};
+
+    Segment* acquire_segment()
+    {
+        std::lock_guard lock{pool_lock};
+        if(!free_segments.empty()) {
+            auto* segment = free_segments.back();
+            free_segments.pop_back();
+            return segment;
+        }
+        if(max_segments && segments.size() >= max_segments)
+            return nullptr;
+        segments.push_back(std::make_unique<Segment>());
+        return segments.back().get();
+    }
+
+    void recycle_segment(Segment* segment)
+    {
+        segment->published.store(0, std::memory_order_relaxed);
+        segment->next.store(nullptr, std::memory_order_relaxed);
+        segment->consumed = 0;
+        std::lock_guard lock{pool_lock};
+        free_segments.push_back(segment);
+    }
+
+    op_result pop_locked(ValueType& value)
+    {
+        std::lock_guard lock{head_lock};
+        if(head->consumed == SEGMENT_SIZE) {
+            auto* next = head->next.load(std::memory_order_acquire);
+            if(!next) {
+                if(!closed.load(std::memory_order_acquire))
+                    return op_failed_buffer_empty;
+                next = head->next.load(std::memory_order_acquire);
+                if(!next)
+                    return error_closed;
+            }
+            // the producer moved on to `next` before publishing it, so
+            // nothing references the drained segment any more
+            auto* drained = std::exchange(head, next);
+            recycle_segment(drained);
+        }
+        if(head->consumed == head->published.load(std::memory_order_acquire)) {
+            // check closed before re-reading published: a push that beat
+            // close() is still delivered
+            if(!closed.load(std::memory_order_acquire) ||
+               head->consumed != head->published.load(std::memory_order_acquire) ||
+               head->next.load(std::memory_order_acquire))
+                return op_failed_buffer_empty;
+            return error_closed;
+        }
+        value = std::ranges::iter_move(head->slots.begin() + head->consumed);
+        ++head->consumed;
+        popped.fetch_add(1, std::memory_order_release);
+        return ok;
+    }
+
+  public:
+    // soft_capacity 0 keeps the queue unbounded; otherwise it is rounded up
+    // to whole segments (plus the one being drained)
+    explicit SegmentedQueue(SizeType soft_capacity = 0, SizeType preallocated_segments = 1)
+    {
+        if(soft_capacity)
+            max_segments = (soft_capacity + SEGMENT_SIZE - 1) / SEGMENT_SIZE + 1;
+        preallocated_segments = std::max<SizeType>(1, preallocated_segments);
+        if(max_segments)
+            preallocated_segments = std::min(preallocated_segments, max_segments);
+        for(SizeType i = 0; i < preallocated_segments; ++i)
+            segments.push_back(std::make_unique<Segment>());
+        head = tail = segments.front().get();
+        for(SizeType i = 1; i < preallocated_segments; ++i)
+            free_segments.push_back(segments[i].get());
+    }
+
+    SegmentedQueue(const SegmentedQueue&) = delete;
+    SegmentedQueue(SegmentedQueue&&) = delete;
+    auto operator=(const SegmentedQueue&) = delete;
+    auto operator=(SegmentedQueue&&) = delete;
+    ~SegmentedQueue() = default;
+
+    // taken under the tail lock so no push can publish after close() returns
+    void close()
+    {
+        std::lock_guard lock{tail_lock};
+        closed.store(true, std::memory_order_release);
+    }
+
+    SizeType size() const noexcept
+    {
+        const auto popped_count = popped.load(std::memory_order_acquire);
+        const auto pushed_count = pushed.load(std::memory_order_acquire);
+        return pushed_count > popped_count ? pushed_count - popped_count : 0;
+    }
+
+    // segments currently allocated, in use or pooled
+    SizeType allocated_segments()
+    {
+        std::lock_guard lock{pool_lock};
+        return segments.size();
+    }
+
+    template<typename PushedValueType>
+        requires std::convertible_to<PushedValueType, ValueType>
+    void push(PushedValueType&& value)
+    {
+        adaptive_wait await{};
+        for(;;) {
+            auto push_result = try_push(std::forward<PushedValueType>(value));
+            if(push_result == error_closed)
+                throw std::runtime_error("invalid buffer state");
+            if(push_result == ok)
+                return;
+            await.wait();
+        }
+    }
+
+    ValueType pop()
+    {
+        adaptive_wait await{};
+        ValueType value{};
+        for(;;) {
+            auto pop_status = try_pop(value);
+            if(pop_status == error_closed)
+                throw std::runtime_error("invalid buffer state");
+            else if(pop_status == ok)
+                return value;
+            await.wait();
+        }
+    }
+
+    template<typename PushedValueType>
+        requires std::convertible_to<PushedValueType, ValueType>
+    op_result try_push(PushedValueType&& value)
+    {
+        std::lock_guard lock{tail_lock};
+        if(closed.load(std::memory_order_relaxed))
+            return error_closed;
+        auto position = tail->published.load(std::memory_order_relaxed);
+        if(position == SEGMENT_SIZE) {
+            auto* next = acquire_segment();
+            if(!next)
+                return op_failed_buffer_full;
+            tail->next.store(next, std::memory_order_release);
+            tail = next;
+            position = 0;
+        }
+        tail->slots[position] = std::forward<PushedValueType>(value);
+        if constexpr(requires { tail->slots[position].on_enqueue(); })
+            tail->slots[position].on_enqueue(); // latency tracing, see latency_trace.h
+        tail->published.store(position + 1, std::memory_order_release);
+        pushed.fetch_add(1, std::memory_order_release);
+        return ok;
+    }
+
+    op_result try_pop(ValueType& value)
+    {
+        const auto result = pop_locked(value);
+        // outside the head lock, so tracing never holds up other consumers
+        if constexpr(requires { value.on_dequeue(); }) {
+            if(result == ok)
+                value.on_dequeue();
+        }
+        return result;
+    }
+};
+
+#endif // SEGMENTED_QUEUE_H
@@ -0,0 +1,296 @@
+#ifndef SHARDED_QUEUE_H
+#define SHARDED_QUEUE_H
+
+#include "adaptive_wait.h"
+#include "cache_line.h"
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <memory>
+#include <sched.h>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Multi-queue built from RingBuffer shards, for many producers feeding many
+// consumers. Every producer and consumer has a home shard: producers push
+// into theirs, consumers drain theirs and steal from the others once it is
+// empty, so threads only contend on a shared position when they meet on a
+// shard. Steal scans skip shards that look empty without taking their locks.
+//
+// Homes are assigned per queue through handles. producer() claims the shard
+// with the fewest producers and consumer() a slot that is mapped onto the
+// shards producers currently hold, so a consumer's home is one that receives
+// pushes; both are given back when the handle is destroyed:
+//
+//   auto producer = queue.producer();   // in each producer thread
+//   producer.push(value);
+//   auto consumer = queue.consumer();   // in each consumer thread
+//   auto value = consumer.pop();
+//
+// The queue's own push/pop/try_push/try_pop home on the calling thread's
+// CPU instead and keep the RingBuffer contract. Elements from one producer
+// keep their order within a shard, but there is no FIFO order across
+// shards. When the home shard is full, push() moves on to the next shard
+// with room before it waits.
+template<std::semiregular ValueType, class Allocator = std::allocator<ValueType>>
+class ShardedQueue
+{
+    using Shard = RingBuffer<ValueType, Allocator>;
+
+  public:
+    using SizeType = std::size_t;
+    using op_result = typename Shard::op_result;
+    static constexpr op_result ok = Shard::ok;
+    static constexpr op_result error_closed = Shard::error_closed;
+    static constexpr op_result op_failed_buffer_empty = Shard::op_failed_buffer_empty;
+    static constexpr op_result op_failed_buffer_full = Shard::op_failed_buffer_full;
+
+  private:
+    // registered handles per shard
+    struct alignas(std::hardware_destructive_interference_size) shard_load
+    {
+        std::atomic<SizeType> producers{0};
+        std::atomic<SizeType> consumers{0};
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<shard_load> loads;
+    alignas(std::hardware_destructive_interference_size) std::atomic<SizeType> active_producers{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic_bool closed{false};
+
+    // the least loaded shard; concurrent claims may pick the same one
+    SizeType claim(std::atomic<SizeType> shard_load::*counter) noexcept
+    {
+        SizeType best = 0;
+        for(SizeType i = 1; i < loads.size(); ++i)
+            if((loads[i].*counter).load(std::memory_order_relaxed) < (loads[best].*counter).load(std::memory_order_relaxed))
+                best = i;
+        (loads[best].*counter).fetch_add(1, std::memory_order_relaxed);
+        return best;
+    }
+
+    // producers fill the least loaded shards first, so while none leaves
+    // they hold the first `active_producers` shards
+    SizeType consumer_home(SizeType slot) const noexcept
+    {
+        const auto producers = active_producers.load(std::memory_order_relaxed);
+        return slot % std::clamp<SizeType>(producers, 1, shards.size());
+    }
+
+    SizeType cpu_home() const noexcept
+    {
+        const auto cpu = sched_getcpu();
+        return cpu < 0 ? 0 : static_cast<SizeType>(cpu) % shards.size();
+    }
+
+    template<typename PushedValueType>
+    op_result try_push_from(SizeType home, PushedValueType&& value)
+    {
+        for(SizeType i = 0; i < shards.size(); ++i) {
+            auto& shard = *shards[(home + i) % shards.size()];
+            // a failed try_push leaves the value untouched
+            const auto push_result = shard.try_push(std::forward<PushedValueType>(value));
+            if(push_result != op_failed_buffer_full)
+                return push_result;
+        }
+        return op_failed_buffer_full;
+    }
+
+    // Drains the home shard, then steals from the others in turn, skipping
+    // the ones that look empty. Once the queue is closed every shard is
+    // asked: closed shards stay closed and empty, so error_closed is
+    // reported only once every shard said so in the same scan.
+    op_result try_pop_from(SizeType home, ValueType& value)
+    {
+        for(SizeType i = 0; i < shards.size(); ++i) {
+            auto& shard = *shards[(home + i) % shards.size()];
+            if(!shard.appears_empty() && shard.try_pop(value) == ok)
+                return ok;
+        }
+        if(!closed.load(std::memory_order_acquire))
+            return op_failed_buffer_empty;
+        auto all_closed = true;
+        for(SizeType i = 0; i < shards.size(); ++i) {
+            const auto pop_status = shards[(home + i) % shards.size()]->try_pop(value);
+            if(pop_status == ok)
+                return ok;
+            all_closed = all_closed && pop_status == error_closed;
+        }
+        return all_closed ? error_closed : op_failed_buffer_empty;
+    }
+
+    template<class Home, typename PushedValueType>
+    void push_from(Home home, PushedValueType&& value)
+    {
+        adaptive_wait await{};
+        for(;;) {
+            auto push_result = try_push_from(home(), std::forward<PushedValueType>(value));
+            if(push_result == error_closed)
+                throw std::runtime_error("invalid buffer state");
+            if(push_result == ok)
+                return;
+            await.wait();
+        }
+    }
+
+    template<class Home>
+    ValueType pop_from(Home home)
+    {
+        adaptive_wait await{};
+        ValueType value{};
+        for(;;) {
+            auto pop_status = try_pop_from(home(), value);
+            if(pop_status == error_closed)
+                throw std::runtime_error("invalid buffer state");
+            else if(pop_status == ok)
+                return value;
+            await.wait();
+        }
+    }
+
+  public:
+    // pushes from the shard claimed at construction
+    class producer_handle
+    {
+        ShardedQueue* queue;
+        SizeType shard;
+
+      public:
+        explicit producer_handle(ShardedQueue& owner)
+            : queue(&owner), shard(owner.claim(&shard_load::producers))
+        {
+            queue->active_producers.fetch_add(1, std::memory_order_relaxed);
+        }
+        producer_handle(producer_handle&& other) noexcept
+            : queue(std::exchange(other.queue, nullptr)), shard(other.shard) {}
+        producer_handle(const producer_handle&) = delete;
+        auto operator=(const producer_handle&) = delete;
+        auto operator=(producer_handle&&) = delete;
+        ~producer_handle()
+        {
+            if(!queue)
+                return;
+            queue->loads[shard].producers.fetch_sub(1, std::memory_order_relaxed);
+            queue->active_producers.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        SizeType home_shard() const noexcept { return shard; }
+
+        template<typename PushedValueType>
+            requires std::convertible_to<PushedValueType, ValueType>
+        void push(PushedValueType&& value)
+        {
+            queue->push_from([this] { return shard; }, std::forward<PushedValueType>(value));
+        }
+
+        template<typename PushedValueType>
+            requires std::convertible_to<PushedValueType, ValueType>
+        op_result try_push(PushedValueType&& value)
+        {
+            return queue->try_push_from(shard, std::forward<PushedValueType>(value));
+        }
+    };
+
+    // pops from a home that follows the shards producers hold
+    class consumer_handle
+    {
+        ShardedQueue* queue;
+        SizeType slot;
+
+      public:
+        explicit consumer_handle(ShardedQueue& owner) : queue(&owner), slot(owner.claim(&shard_load::consumers)) {}
+        consumer_handle(consumer_handle&& other) noexcept
+            : queue(std::exchange(other.queue, nullptr)), slot(other.slot) {}
+        consumer_handle(const consumer_handle&) = delete;
+        auto operator=(const consumer_handle&) = delete;
+        auto operator=(consumer_handle&&) = delete;
+        ~consumer_handle()
+        {
+            if(queue)
+                queue->loads[slot].consumers.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        SizeType home_shard() const noexcept { return queue->consumer_home(slot); }
+
+        ValueType pop()
+        {
+            return queue->pop_from([this] { return home_shard(); });
+        }
+
+        op_result try_pop(ValueType& value) { return queue->try_pop_from(home_shard(), value); }
+    };
+
+    // capacity is split evenly over the shards; shard_count 0 means one
+    // shard per hardware thread
+    explicit ShardedQueue(SizeType capacity, SizeType shard_count = 0, const Allocator& allocator = Allocator())
+        : loads(shard_count ? shard_count : std::max(1u, std::thread::hardware_concurrency()))
+    {
+        shard_count = loads.size();
+        const auto shard_capacity = std::max<SizeType>(2, (capacity + shard_count - 1) / shard_count);
+        shards.reserve(shard_count);
+        for(SizeType i = 0; i < shard_count; ++i)
+            shards.push_back(std::make_unique<Shard>(shard_capacity, allocator));
+    }
+
+    ShardedQueue(const ShardedQueue&) = delete;
+    ShardedQueue(ShardedQueue&&) = delete;
+    auto operator=(const ShardedQueue&) = delete;
+    auto operator=(ShardedQueue&&) = delete;
+    ~ShardedQueue() = default;
+
+    producer_handle producer() { return producer_handle(*this); }
+    consumer_handle consumer() { return consumer_handle(*this); }
+
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        for(auto& shard : shards)
+            shard->close();
+    }
+
+    SizeType shard_count() const noexcept { return shards.size(); }
+
+    SizeType capacity() const noexcept
+    {
+        SizeType total = 0;
+        for(const auto& shard : shards)
+            total += shard->capacity();
+        return total;
+    }
+
+    // a snapshot; shards are counted one after the other
+    SizeType size() const noexcept
+    {
+        SizeType total = 0;
+        for(const auto& shard : shards)
+            total += shard->size();
+        return total;
+    }
+
+    template<typename PushedValueType>
+        requires std::convertible_to<PushedValueType, ValueType>
+    void push(PushedValueType&& value)
+    {
+        push_from([this] { return cpu_home(); }, std::forward<PushedValueType>(value));
+    }
+
+    ValueType pop()
+    {
+        return pop_from([this] { return cpu_home(); });
+    }
+
+    template<typename PushedValueType>
+        requires std::convertible_to<PushedValueType, ValueType>
+    op_result try_push(PushedValueType&& value)
+    {
+        return try_push_from(cpu_home(), std::forward<PushedValueType>(value));
+    }
+
+    op_result try_pop(ValueType& value) { return try_pop_from(cpu_home(), value); }
+};
+
+#endif // SHARDED_QUEUE_H
@@ -1,11 +1,51 @@
 #ifndef SPIN_LOCK_H
 #define SPIN_LOCK_H
 
+#include "cache_line.h"
+
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <emmintrin.h>
+#include <exception>
 #include <thread>
 
+// Lock family sharing the lock()/try_lock()/unlock() interface, so every
+// one of them works with std::lock_guard and std::unique_lock:
+//  - spin_lock:   test-and-test-and-set with exponential backoff
+//  - ticket_lock: FIFO, waiters back off in proportion to their distance
+//                 from the ticket being served
+//  - mcs_lock:    FIFO queue lock, every waiter spins on its own cache line
+// Waiters that spin for longer than spin_budget park on a futex
+// (std::atomic::wait) instead of yielding in a loop; the FIFO locks wake only
+// the next waiter. They still hand the lock to a waiter that may be
+// preempted, so every handoff costs a context switch once threads outnumber
+// cores: prefer spin_lock there.
+
+// Elapsed-time spin limit: a handoff to a spinning waiter takes well under a
+// microsecond, a wake from the futex several, so waiters keep spinning for
+// about the cost of a few context switches whatever the core count.
+class spin_budget
+{
+    static constexpr auto budget = std::chrono::microseconds(20);
+    std::chrono::steady_clock::time_point deadline{};
+
+  public:
+    // the clock starts on the first call, so uncontended paths never read it
+    bool expired() noexcept
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if(deadline == std::chrono::steady_clock::time_point{}) {
+            deadline = now + budget;
+            return false;
+        }
+        return now >= deadline;
+    }
+};
+
 struct spin_lock
 {
     void lock() noexcept
@@ -25,7 +65,8 @@ struct spin_lock
 
         while(true) {
             for(int i = 0; i < iterations[2]; ++i) {
-                if(try_lock())
+                // spin on a plain load: only the winner writes the line
+                if(!flag.test(std::memory_order_relaxed) && try_lock())
                     return;
 
                 _mm_pause();
@@ -39,8 +80,7 @@ struct spin_lock
                 _mm_pause();
                 _mm_pause();
             }
-            std::puts("yield");
-            std::this_thread::yield();
+            flag.wait(true, std::memory_order_relaxed);
         }
     }
 
@@ -52,9 +92,173 @@ struct spin_lock
     void unlock() noexcept
     {
         flag.clear(std::memory_order_release);
+        flag.notify_one();
     }
 
   private:
     std::atomic_flag flag = ATOMIC_FLAG_INIT;
 };
+
+// Partitioned ticket lock: a waiter parks on the grant slot of its own
+// ticket once its spin budget is spent, or straight away when the holder and
+// the waiters ahead of it leave no CPU to spin on. unlock() wakes only the
+// waiters of the next ticket (one, unless more than slot_count threads are
+// queued) instead of every parked thread.
+struct ticket_lock
+{
+    void lock() noexcept
+    {
+        const auto ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        auto& grant = grants[ticket % slot_count];
+        spin_budget budget{};
+        for(;;) {
+            const auto granted = grant.load(std::memory_order_acquire);
+            const auto serving = now_serving.load(std::memory_order_acquire);
+            if(serving == ticket)
+                return;
+            // every waiter ahead of us holds the lock for about the same time
+            const auto distance = ticket - serving;
+            // the holder, the waiters ahead and this one all want a CPU
+            if(distance < online_cpus() && !budget.expired()) {
+                for(std::uint32_t i = 0; i < distance * backoff_base; ++i)
+                    _mm_pause();
+            } else {
+                // unlock() publishes now_serving before the grant, so a
+                // grant missed above changes the slot and wait() returns
+                grant.wait(granted, std::memory_order_acquire);
+            }
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        auto serving = now_serving.load(std::memory_order_acquire);
+        auto expected = serving;
+        return next_ticket.compare_exchange_strong(expected, serving + 1, std::memory_order_acquire,
+                                                   std::memory_order_relaxed);
+    }
+
+    void unlock() noexcept
+    {
+        const auto next = now_serving.load(std::memory_order_relaxed) + 1;
+        now_serving.store(next, std::memory_order_release);
+        auto& grant = grants[next % slot_count];
+        grant.store(next, std::memory_order_release);
+        grant.notify_all();
+    }
+
+  private:
+    static constexpr std::uint32_t backoff_base = 32;
+    static constexpr std::uint32_t slot_count = 32;
+
+    static std::uint32_t online_cpus() noexcept
+    {
+        static const std::uint32_t cpus = std::max(1u, std::thread::hardware_concurrency());
+        return cpus;
+    }
+
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::uint32_t> next_ticket{0};
+    alignas(std::hardware_destructive_interference_size) std::atomic<std::uint32_t> now_serving{0};
+    // last ticket granted through each slot; parked waiters sleep on these
+    alignas(std::hardware_destructive_interference_size) std::array<std::atomic<std::uint32_t>, slot_count> grants{};
+};
+
+// Queue nodes come from a small per-thread pool, so one thread may hold up
+// to max_held_locks mcs_locks at a time without passing nodes around.
+struct mcs_lock
+{
+    static constexpr std::size_t max_held_locks = 8;
+
+    void lock() noexcept
+    {
+        auto* node = acquire_node();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->locked.store(true, std::memory_order_relaxed);
+        auto* predecessor = tail.exchange(node, std::memory_order_acq_rel);
+        if(predecessor) {
+            predecessor->next.store(node, std::memory_order_release);
+            spin_budget budget{};
+            for(std::uint32_t i = 1; node->locked.load(std::memory_order_acquire); ++i) {
+                // the clock is read once per budget_check_interval pauses
+                if(i % budget_check_interval != 0 || !budget.expired())
+                    _mm_pause();
+                else
+                    node->locked.wait(true, std::memory_order_acquire);
+            }
+        }
+        holder = node;
+    }
+
+    bool try_lock() noexcept
+    {
+        auto* node = acquire_node();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->locked.store(true, std::memory_order_relaxed);
+        queue_node* expected = nullptr;
+        if(tail.compare_exchange_strong(expected, node, std::memory_order_acquire, std::memory_order_relaxed)) {
+            holder = node;
+            return true;
+        }
+        release_node(node);
+        return false;
+    }
+
+    void unlock() noexcept
+    {
+        auto* node = holder;
+        auto* successor = node->next.load(std::memory_order_acquire);
+        if(!successor) {
+            auto* expected = node;
+            if(tail.compare_exchange_strong(expected, nullptr, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                release_node(node);
+                return;
+            }
+            // a waiter swapped the tail but has not linked itself yet
+            for(std::uint32_t i = 0; !(successor = node->next.load(std::memory_order_acquire)); ++i) {
+                if(i < link_spins)
+                    _mm_pause();
+                else
+                    std::this_thread::yield(); // the waiter was preempted
+            }
+        }
+        successor->locked.store(false, std::memory_order_release);
+        successor->locked.notify_one();
+        release_node(node);
+    }
+
+  private:
+    static constexpr std::uint32_t budget_check_interval = 64;
+    static constexpr std::uint32_t link_spins = 128;
+
+    struct alignas(std::hardware_destructive_interference_size) queue_node
+    {
+        std::atomic<queue_node*> next{nullptr};
+        std::atomic_bool locked{false};
+        bool in_use{false};
+    };
+
+    static queue_node* acquire_node() noexcept
+    {
+        for(auto& node : thread_nodes())
+            if(!node.in_use) {
+                node.in_use = true;
+                return &node;
+            }
+        // more than max_held_locks mcs_locks held by this thread
+        std::terminate();
+    }
+
+    static void release_node(queue_node* node) noexcept { node->in_use = false; }
+
+    static std::array<queue_node, max_held_locks>& thread_nodes() noexcept
+    {
+        thread_local std::array<queue_node, max_held_locks> nodes{};
+        return nodes;
+    }
+
+    alignas(std::hardware_destructive_interference_size) std::atomic<queue_node*> tail{nullptr};
+    // written by the holder only, read back in unlock()
+    alignas(std::hardware_destructive_interference_size) queue_node* holder{nullptr};
+};
 #endif
@@ -0,0 +1,287 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// CPU/NUMA layout read from sysfs, thread pinning and node-local memory.
+// Kernels without NUMA support (no /sys/devices/system/node) are reported
+// as a single node 0 holding every online cpu.
+
+struct CpuInfo
+{
+    unsigned cpu{0};
+    unsigned core{0};
+    unsigned package{0};
+    unsigned node{0};
+};
+
+// parses sysfs cpu lists such as "0-3,8,10-11"
+inline std::vector<unsigned> parse_cpu_list(const std::string& list)
+{
+    std::vector<unsigned> cpus;
+    std::istringstream is(list);
+    std::string range;
+    while(std::getline(is, range, ',')) {
+        if(range.empty() || range == "\n")
+            continue;
+        const auto dash = range.find('-');
+        const auto first = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+        const auto last = dash == std::string::npos ? first : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+        for(auto cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+class CpuTopology
+{
+    std::vector<CpuInfo> m_cpus;
+    std::map<unsigned, std::vector<unsigned>> m_nodeCpus;
+
+    static std::string read_line(const std::string& path)
+    {
+        std::ifstream is(path);
+        std::string line;
+        std::getline(is, line);
+        return line;
+    }
+
+    static unsigned read_id(const std::string& path, unsigned fallback)
+    {
+        const auto line = read_line(path);
+        return line.empty() ? fallback : static_cast<unsigned>(std::stoul(line));
+    }
+
+  public:
+    static CpuTopology detect(const std::string& sysfsRoot = "/sys/devices/system")
+    {
+        CpuTopology topology;
+        auto online = parse_cpu_list(read_line(sysfsRoot + "/cpu/online"));
+        if(online.empty())
+            for(unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                online.push_back(cpu);
+
+        std::map<unsigned, unsigned> cpuNode;
+        for(auto node : parse_cpu_list(read_line(sysfsRoot + "/node/online")))
+            for(auto cpu : parse_cpu_list(read_line(sysfsRoot + "/node/node" + std::to_string(node) + "/cpulist")))
+                cpuNode[cpu] = node;
+
+        for(auto cpu : online) {
+            const auto base = sysfsRoot + "/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            CpuInfo info{cpu, read_id(base + "core_id", cpu), read_id(base + "physical_package_id", 0),
+                         cpuNode.count(cpu) ? cpuNode[cpu] : 0};
+            topology.m_cpus.push_back(info);
+            topology.m_nodeCpus[info.node].push_back(cpu);
+        }
+        return topology;
+    }
+
+    const std::vector<CpuInfo>& cpus() const noexcept { return m_cpus; }
+
+    std::vector<unsigned> nodes() const
+    {
+        std::vector<unsigned> result;
+        for(const auto& [node, cpus] : m_nodeCpus)
+            result.push_back(node);
+        return result;
+    }
+
+    // cpus of the node ordered so that distinct physical cores come before
+    // their hyper-thread siblings
+    std::vector<unsigned> node_cpus(unsigned node) const
+    {
+        std::vector<CpuInfo> infos;
+        for(const auto& info : m_cpus)
+            if(info.node == node)
+                infos.push_back(info);
+        std::map<std::pair<unsigned, unsigned>, unsigned> siblingRank;
+        std::vector<std::pair<unsigned, unsigned>> ranked;
+        for(const auto& info : infos)
+            ranked.emplace_back(siblingRank[{info.package, info.core}]++, info.cpu);
+        std::stable_sort(ranked.begin(), ranked.end(),
+                         [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        std::vector<unsigned> result;
+        for(const auto& [rank, cpu] : ranked)
+            result.push_back(cpu);
+        return result;
+    }
+
+    unsigned node_of_cpu(unsigned cpu) const
+    {
+        for(const auto& info : m_cpus)
+            if(info.cpu == cpu)
+                return info.node;
+        return 0;
+    }
+
+    unsigned current_node() const
+    {
+        const auto cpu = sched_getcpu();
+        return cpu < 0 ? 0 : node_of_cpu(static_cast<unsigned>(cpu));
+    }
+};
+
+inline bool pin_thread(pthread_t thread, const std::vector<unsigned>& cpus) noexcept
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(auto cpu : cpus)
+        if(cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+inline bool pin_current_thread(const std::vector<unsigned>& cpus) noexcept
+{
+    return pin_thread(pthread_self(), cpus);
+}
+
+// Hands out the cpus of one node round robin, one core per thread, so a
+// whole parse->queue->consume chain stays on a single socket.
+class NodePlacement
+{
+    unsigned m_node{0};
+    std::vector<unsigned> m_cpus;
+    std::size_t m_next{0};
+
+  public:
+    NodePlacement(const CpuTopology& topology, unsigned node)
+        : m_node(node), m_cpus(topology.node_cpus(node)) {}
+
+    unsigned node() const noexcept { return m_node; }
+    const std::vector<unsigned>& cpus() const noexcept { return m_cpus; }
+
+    // not thread safe; assign cores from the thread that spawns the workers
+    unsigned next_cpu() noexcept
+    {
+        if(m_cpus.empty())
+            return 0;
+        return m_cpus[m_next++ % m_cpus.size()];
+    }
+
+    // the thread pins itself before running function, so nothing it
+    // allocates is first touched on another node
+    template<class Function, class... Args>
+    std::thread spawn(Function&& function, Args&&... args)
+    {
+        const auto pinned = !m_cpus.empty();
+        return std::thread(
+            [pinned, cpu = next_cpu()](auto&& task, auto&&... task_args) {
+                if(pinned)
+                    pin_current_thread({cpu});
+                std::invoke(std::move(task), std::move(task_args)...);
+            },
+            std::forward<Function>(function), std::forward<Args>(args)...);
+    }
+};
+
+// Maps pages with a preferred-node memory policy (mbind(2) is called
+// through syscall() so no libnuma is needed). The policy is a preference:
+// when the node is out of memory, or the kernel lacks NUMA support, the
+// allocation falls back to any node instead of failing.
+inline void* allocate_on_node(std::size_t bytes, int node)
+{
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED)
+        throw std::bad_alloc();
+#ifdef SYS_mbind
+    if(node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8)) {
+        constexpr int mpol_preferred = 1;
+        const unsigned long nodeMask = 1UL << node;
+        // the kernel reads maxnode - 1 bits, so one more than the mask holds
+        syscall(SYS_mbind, ptr, bytes, mpol_preferred, &nodeMask, sizeof(nodeMask) * 8 + 1, 0);
+    }
+#endif
+    return ptr;
+}
+
+inline void deallocate_on_node(void* ptr, std::size_t bytes) noexcept
+{
+    if(ptr)
+        munmap(ptr, bytes);
+}
+
+// std::allocator replacement placing whole allocations on a NUMA node;
+// node -1 keeps the plain operator new behaviour.
+template<class ValueType>
+struct numa_allocator
+{
+    using value_type = ValueType;
+    int node{-1};
+
+    numa_allocator() noexcept = default;
+    explicit numa_allocator(int preferred_node) noexcept : node(preferred_node) {}
+    template<class OtherType>
+    numa_allocator(const numa_allocator<OtherType>& other) noexcept : node(other.node) {}
+
+    ValueType* allocate(std::size_t count)
+    {
+        if(count > std::numeric_limits<std::size_t>::max() / sizeof(ValueType))
+            throw std::bad_array_new_length();
+        if(node < 0)
+            return std::allocator<ValueType>{}.allocate(count);
+        return static_cast<ValueType*>(allocate_on_node(count * sizeof(ValueType), node));
+    }
+
+    void deallocate(ValueType* ptr, std::size_t count) noexcept
+    {
+        if(node < 0)
+            std::allocator<ValueType>{}.deallocate(ptr, count);
+        else
+            deallocate_on_node(ptr, count * sizeof(ValueType));
+    }
+
+    template<class OtherType>
+    bool operator==(const numa_allocator<OtherType>& other) const noexcept
+    {
+        return node == other.node;
+    }
+};
+
+template<class ValueType>
+struct node_deleter
+{
+    void operator()(ValueType* ptr) const noexcept
+    {
+        if(!ptr)
+            return;
+        ptr->~ValueType();
+        deallocate_on_node(ptr, sizeof(ValueType));
+    }
+};
+
+template<class ValueType>
+using node_local_ptr = std::unique_ptr<ValueType, node_deleter<ValueType>>;
+
+// Constructs an object, e.g. a FileParser with its inline chunk buffer,
+// in memory preferring the given node.
+template<class ValueType, class... Args>
+node_local_ptr<ValueType> make_on_node(int node, Args&&... args)
+{
+    void* ptr = allocate_on_node(sizeof(ValueType), node);
+    try {
+        return node_local_ptr<ValueType>(new(ptr) ValueType(std::forward<Args>(args)...));
+    } catch(...) {
+        deallocate_on_node(ptr, sizeof(ValueType));
+        throw;
+    }
+}
+
+#endif // TOPOLOGY_H